@@ -0,0 +1,454 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "DataStream/DataStream.hpp"
+#include "DataStream/Descriptor.hpp"
+
+
+
+
+namespace DataStream {
+
+enum class AsyncBackend : std::uint8_t {
+    IoUring, // io_uring submissions, registered buffers and file when the kernel allows it
+    Threads // pwrite() on a small thread pool
+};
+
+struct AsyncCompletion {
+    std::uint64_t user_data = 0;
+    std::int32_t result = 0; // bytes written or -errno
+};
+
+
+// minimal io_uring, set up with raw system calls, writes only
+class IoUring {
+private:
+    int ring_fd = -1;
+    void* sq_ring = nullptr;
+    void* cq_ring = nullptr;
+    std::size_t sq_ring_size = 0;
+    std::size_t cq_ring_size = 0;
+    struct io_uring_sqe* sqes = nullptr;
+    std::size_t sqes_size = 0;
+
+    unsigned* sq_tail = nullptr;
+    unsigned* sq_mask = nullptr;
+    unsigned* sq_array = nullptr;
+    unsigned* cq_head = nullptr;
+    unsigned* cq_tail = nullptr;
+    unsigned* cq_mask = nullptr;
+    struct io_uring_cqe* cqes = nullptr;
+    unsigned unsubmitted = 0;
+
+    bool fixed_buffers = false;
+    bool fixed_file = false;
+
+    inline void close() {
+        if (this->sqes)
+            ::munmap(this->sqes, this->sqes_size);
+        if (this->cq_ring && this->cq_ring != this->sq_ring)
+            ::munmap(this->cq_ring, this->cq_ring_size);
+        if (this->sq_ring)
+            ::munmap(this->sq_ring, this->sq_ring_size);
+        if (this->ring_fd >= 0)
+            ::close(this->ring_fd);
+        this->sqes = nullptr;
+        this->sq_ring = this->cq_ring = nullptr;
+        this->ring_fd = -1;
+    }
+
+    inline int enter(unsigned submit, unsigned wait, unsigned flags) {
+        for (;;) {
+            const long result = ::syscall(__NR_io_uring_enter, this->ring_fd, submit, wait, flags, nullptr, 0);
+            if (result >= 0)
+                return static_cast<int>(result);
+            if (errno != EINTR)
+                throw DataStream::io_error("io_uring_enter failed");
+        }
+    }
+
+
+public:
+    // throws if io_uring is not available
+    explicit IoUring(unsigned entries) {
+        struct io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        this->ring_fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+        if (this->ring_fd < 0)
+            throw DataStream::io_error("io_uring_setup failed");
+
+        this->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        this->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+        const bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single)
+            this->sq_ring_size = this->cq_ring_size = std::max(this->sq_ring_size, this->cq_ring_size);
+
+        auto map = [&](std::size_t size, off_t offset) {
+            void* memory = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, this->ring_fd, offset);
+            if (memory == MAP_FAILED) {
+                const int error = errno;
+                this->close();
+                throw DataStream::io_error("io_uring mmap failed", error);
+            }
+            return memory;
+        };
+        this->sq_ring = map(this->sq_ring_size, IORING_OFF_SQ_RING);
+        this->cq_ring = single ? this->sq_ring : map(this->cq_ring_size, IORING_OFF_CQ_RING);
+        this->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+        this->sqes = static_cast<struct io_uring_sqe*>(map(this->sqes_size, IORING_OFF_SQES));
+
+        std::uint8_t* sq = static_cast<std::uint8_t*>(this->sq_ring);
+        std::uint8_t* cq = static_cast<std::uint8_t*>(this->cq_ring);
+        this->sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        this->sq_mask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        this->sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        this->cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        this->cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        this->cq_mask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        this->cqes = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+    }
+
+    ~IoUring() {
+        this->close();
+    }
+
+    IoUring(const IoUring& o) = delete;
+    IoUring& operator=(const IoUring& o) = delete;
+
+    // pins the buffers so writes skip per request page mapping, fails quietly (RLIMIT_MEMLOCK)
+    inline bool register_buffers(std::span<const struct iovec> buffers) {
+        this->fixed_buffers = ::syscall(__NR_io_uring_register, this->ring_fd, IORING_REGISTER_BUFFERS, buffers.data(), buffers.size()) == 0;
+        return this->fixed_buffers;
+    }
+
+    // registers the descriptor as fixed file 0, so requests skip the file table lookup
+    inline bool register_file(int fd) {
+        this->fixed_file = ::syscall(__NR_io_uring_register, this->ring_fd, IORING_REGISTER_FILES, &fd, 1) == 0;
+        return this->fixed_file;
+    }
+
+    // queues a write for the next submit() or wait(), the caller never has more requests in flight than
+    // the ring has entries
+    inline void write(std::uint64_t user_data, int fd, const std::uint8_t* data, std::size_t size, std::size_t offset, unsigned buffer_index) {
+        const unsigned tail = *this->sq_tail;
+        const unsigned index = tail & *this->sq_mask;
+        struct io_uring_sqe* sqe = this->sqes + index;
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = this->fixed_buffers ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+        sqe->flags = this->fixed_file ? IOSQE_FIXED_FILE : 0;
+        sqe->fd = this->fixed_file ? 0 : fd;
+        sqe->off = offset;
+        sqe->addr = reinterpret_cast<std::uint64_t>(data);
+        sqe->len = static_cast<std::uint32_t>(size);
+        sqe->buf_index = static_cast<std::uint16_t>(buffer_index);
+        sqe->user_data = user_data;
+        this->sq_array[index] = index;
+        std::atomic_ref<unsigned>(*this->sq_tail).store(tail + 1, std::memory_order_release);
+        ++this->unsubmitted;
+    }
+
+    inline void submit() {
+        while (this->unsubmitted)
+            this->unsubmitted -= this->enter(this->unsubmitted, 0, 0);
+    }
+
+    // submits what is queued and blocks for the next completion
+    inline DataStream::AsyncCompletion wait() {
+        for (;;) {
+            const unsigned head = *this->cq_head;
+            if (head != std::atomic_ref<unsigned>(*this->cq_tail).load(std::memory_order_acquire)) {
+                const struct io_uring_cqe& cqe = this->cqes[head & *this->cq_mask];
+                const DataStream::AsyncCompletion completion = { cqe.user_data, cqe.res };
+                std::atomic_ref<unsigned>(*this->cq_head).store(head + 1, std::memory_order_release);
+                this->submit();
+                return completion;
+            }
+            this->unsubmitted -= this->enter(this->unsubmitted, 1, IORING_ENTER_GETEVENTS);
+        }
+    }
+};
+
+
+// pwrite() on worker threads, with the same submit/wait interface as IoUring
+class AsyncWritePool {
+private:
+    struct Job {
+        std::uint64_t user_data;
+        int fd;
+        const std::uint8_t* data;
+        std::size_t size;
+        std::size_t offset;
+    };
+
+    std::mutex mutex;
+    std::condition_variable jobs_ready;
+    std::condition_variable completions_ready;
+    std::deque<Job> jobs;
+    std::deque<DataStream::AsyncCompletion> completions;
+    bool stopping = false;
+    std::vector<std::thread> workers;
+
+    inline void work() {
+        for (;;) {
+            Job job;
+            {
+                std::unique_lock lock(this->mutex);
+                this->jobs_ready.wait(lock, [&] { return this->stopping || !this->jobs.empty(); });
+                if (this->jobs.empty())
+                    return;
+                job = this->jobs.front();
+                this->jobs.pop_front();
+            }
+            ssize_t written;
+            do {
+                written = ::pwrite(job.fd, job.data, job.size, static_cast<off_t>(job.offset));
+            } while (written < 0 && errno == EINTR);
+            {
+                std::lock_guard lock(this->mutex);
+                this->completions.push_back({ job.user_data, static_cast<std::int32_t>(written < 0 ? -errno : written) });
+            }
+            this->completions_ready.notify_one();
+        }
+    }
+
+
+public:
+    explicit AsyncWritePool(std::size_t threads) {
+        for (std::size_t i = 0; i < threads; ++i)
+            this->workers.emplace_back([this] { this->work(); });
+    }
+
+    ~AsyncWritePool() {
+        {
+            std::lock_guard lock(this->mutex);
+            this->stopping = true;
+        }
+        this->jobs_ready.notify_all();
+        for (std::thread& worker : this->workers)
+            worker.join();
+    }
+
+    AsyncWritePool(const AsyncWritePool& o) = delete;
+    AsyncWritePool& operator=(const AsyncWritePool& o) = delete;
+
+    inline void write(std::uint64_t user_data, int fd, const std::uint8_t* data, std::size_t size, std::size_t offset, unsigned) {
+        {
+            std::lock_guard lock(this->mutex);
+            this->jobs.push_back({ user_data, fd, data, size, offset });
+        }
+        this->jobs_ready.notify_one();
+    }
+
+    inline void submit() {}
+
+    inline DataStream::AsyncCompletion wait() {
+        std::unique_lock lock(this->mutex);
+        this->completions_ready.wait(lock, [&] { return !this->completions.empty(); });
+        const DataStream::AsyncCompletion completion = this->completions.front();
+        this->completions.pop_front();
+        return completion;
+    }
+};
+
+
+// sequential writer over a seekable file descriptor (not owned) that keeps up to `depth` aligned blocks
+// of `block_size` bytes in flight while the caller keeps serializing into the next one
+//
+// writes go to increasing offsets from the descriptor's position at construction, when every block is
+// in flight operator<< waits for the oldest one (backpressure), flush() submits the partial block, waits
+// for every completion and moves the descriptor's position to the end of the written data, a write error
+// leaves a hole in the file so it is kept and thrown by every later operator<< and flush()
+//
+// with io_uring a full block is submitted as soon as it is queued, so it is written while the next one
+// is serialized, when no free block is left its submission shares the io_uring_enter() that waits for
+// the oldest completion
+template <std::endian endiannes = std::endian::native>
+class AsyncFileStream : public DataStream::StreamOperators<AsyncFileStream<endiannes>, endiannes, true, false> {
+private:
+    friend DataStream::StreamOperators<AsyncFileStream<endiannes>, endiannes, true, false>;
+
+    static constexpr std::size_t alignment = 4096;
+
+    struct Block {
+        std::uint8_t* data = nullptr;
+        std::size_t size = 0; // bytes submitted
+        std::size_t written = 0; // bytes completed
+        std::size_t offset = 0; // file offset of data[0]
+    };
+
+    int fd = -1;
+    std::size_t block_size = 0;
+    std::size_t offset = 0; // file offset of the current block
+    DataStream::AlignedBuffer memory;
+    std::vector<Block> blocks;
+    std::vector<std::size_t> free_blocks;
+    std::size_t current = 0;
+    std::size_t filled = 0;
+    std::size_t in_flight = 0;
+    int error = 0; // errno of the first failed write, never cleared
+
+    std::unique_ptr<DataStream::IoUring> ring;
+    std::unique_ptr<DataStream::AsyncWritePool> pool;
+
+    // submits the unwritten rest of a block, when `waiting` the io_uring request is only queued for the
+    // wait() that follows, which submits it in the same io_uring_enter()
+    inline void submit(std::size_t b, bool waiting = false) {
+        Block& block = this->blocks[b];
+        const std::uint8_t* data = block.data + block.written;
+        const std::size_t size = block.size - block.written;
+        if (this->ring) {
+            this->ring->write(b, this->fd, data, size, block.offset + block.written, static_cast<unsigned>(b));
+            if (!waiting)
+                this->ring->submit();
+        } else {
+            this->pool->write(b, this->fd, data, size, block.offset + block.written, static_cast<unsigned>(b));
+        }
+    }
+
+    // handles one completion, resubmitting the rest of a partial write
+    inline void complete() {
+        const DataStream::AsyncCompletion completion = this->ring ? this->ring->wait() : this->pool->wait();
+        Block& block = this->blocks[completion.user_data];
+        if (completion.result == -EINTR || completion.result == -EAGAIN) {
+            this->submit(completion.user_data);
+            return;
+        }
+        if (completion.result <= 0) {
+            if (!this->error)
+                this->error = completion.result ? -completion.result : EIO;
+        } else {
+            block.written += completion.result;
+            if (block.written < block.size) {
+                this->submit(completion.user_data);
+                return;
+            }
+        }
+        --this->in_flight;
+        this->free_blocks.push_back(completion.user_data);
+    }
+
+    inline void check() {
+        if (this->error)
+            throw DataStream::io_error("file write failed", this->error);
+    }
+
+    // submits the current block and takes a free one, waiting for a completion if there is none
+    inline void rotate() {
+        Block& block = this->blocks[this->current];
+        block.size = this->filled;
+        block.written = 0;
+        block.offset = this->offset;
+        this->offset += this->filled;
+        this->filled = 0;
+        ++this->in_flight;
+        this->submit(this->current, this->free_blocks.empty());
+
+        while (this->free_blocks.empty())
+            this->complete();
+        this->current = this->free_blocks.back();
+        this->free_blocks.pop_back();
+        this->check();
+    }
+
+    inline void write(const std::uint8_t* data, std::size_t size) {
+        this->check();
+        while (size) {
+            const std::size_t count = std::min(size, this->block_size - this->filled);
+            std::copy_n(data, count, this->blocks[this->current].data + this->filled);
+            this->filled += count;
+            data += count;
+            size -= count;
+            if (this->filled == this->block_size)
+                this->rotate();
+        }
+    }
+
+
+public:
+    // block_size is rounded up to a multiple of 4 KiB, depth is the number of blocks
+    explicit AsyncFileStream(int fd, std::size_t block_size = 1024 * 1024, std::size_t depth = 4, DataStream::AsyncBackend backend = DataStream::AsyncBackend::IoUring)
+        : fd(fd),
+        block_size((std::max<std::size_t>(block_size, 1) + alignment - 1) / alignment * alignment)
+    {
+        if (this->fd < 0)
+            throw std::invalid_argument("invalid file descriptor");
+        if (depth < 2)
+            throw std::invalid_argument("depth must be at least 2");
+        const off_t position = ::lseek(this->fd, 0, SEEK_CUR);
+        if (position < 0)
+            throw DataStream::io_error("file seek failed");
+        this->offset = static_cast<std::size_t>(position);
+
+        this->memory = DataStream::aligned_buffer(alignment, this->block_size * depth);
+        std::vector<struct iovec> buffers;
+        for (std::size_t b = 0; b < depth; ++b) {
+            this->blocks.push_back({ this->memory.get() + b * this->block_size });
+            buffers.push_back({ this->blocks.back().data, this->block_size });
+        }
+        for (std::size_t b = depth; b-- > 1;)
+            this->free_blocks.push_back(b);
+
+        if (backend == DataStream::AsyncBackend::IoUring) {
+            try {
+                this->ring = std::make_unique<DataStream::IoUring>(static_cast<unsigned>(depth));
+                this->ring->register_buffers(buffers);
+                this->ring->register_file(this->fd);
+            } catch (const std::ios_base::failure&) {
+                this->ring.reset();
+            }
+        }
+        if (!this->ring)
+            this->pool = std::make_unique<DataStream::AsyncWritePool>(std::min<std::size_t>(depth, 4));
+    }
+
+    // pending blocks are written, errors are lost here so call flush() to observe them
+    ~AsyncFileStream() {
+        try {
+            this->flush();
+        } catch (...) {}
+        while (this->in_flight)
+            this->complete();
+    }
+
+    AsyncFileStream(const AsyncFileStream& o) = delete;
+    AsyncFileStream& operator=(const AsyncFileStream& o) = delete;
+    AsyncFileStream(AsyncFileStream&& o) = delete;
+    AsyncFileStream& operator=(AsyncFileStream&& o) = delete;
+
+    inline DataStream::AsyncBackend backend() const {
+        return this->ring ? DataStream::AsyncBackend::IoUring : DataStream::AsyncBackend::Threads;
+    }
+
+    inline void flush() {
+        if (this->filled)
+            this->rotate();
+        while (this->in_flight)
+            this->complete();
+        this->check();
+        if (::lseek(this->fd, static_cast<off_t>(this->offset), SEEK_SET) < 0)
+            throw DataStream::io_error("file seek failed");
+    }
+};
+
+}
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "DataStream/DataStream.hpp"
+#include "DataStream/Descriptor.hpp"
+
+
+
+
+namespace DataStream {
+
+// sequential writer over a file descriptor (file, pipe or socket, not owned) whose writes happen on a
+// background thread: the caller fills one buffer while the thread writes the previous ones
+//
+// at most `buffers` buffers exist, when all of them wait to be written operator<< blocks until the
+// thread frees one (backpressure), a write error drops the buffers still queued and is rethrown by every
+// operator<< or flush() after it
+template <std::endian endiannes = std::endian::native>
+class BackgroundFileStream : public DataStream::StreamOperators<BackgroundFileStream<endiannes>, endiannes, true, false> {
+private:
+    friend DataStream::StreamOperators<BackgroundFileStream<endiannes>, endiannes, true, false>;
+
+    struct Full {
+        std::size_t buffer;
+        std::size_t size;
+    };
+
+    int fd = -1;
+    std::vector<std::vector<std::uint8_t>> buffers;
+    std::size_t current = 0;
+    std::size_t filled = 0;
+
+    std::mutex mutex;
+    std::condition_variable written; // a buffer was freed or the writer went idle
+    std::condition_variable queued; // a buffer is waiting to be written or the stream is closing
+    std::deque<Full> full;
+    std::vector<std::size_t> free_buffers;
+    bool writing = false;
+    bool stopping = false;
+    std::exception_ptr error; // set once, never cleared
+    std::atomic<bool> failed = false; // whether `error` is set, read by write() without the lock
+    std::thread writer;
+
+    inline void work() {
+        std::unique_lock lock(this->mutex);
+        for (;;) {
+            this->queued.wait(lock, [&] { return this->stopping || !this->full.empty(); });
+            if (this->full.empty())
+                return;
+            const Full next = this->full.front();
+            this->full.pop_front();
+            this->writing = true;
+            lock.unlock();
+
+            std::exception_ptr failure;
+            try {
+                DataStream::write_all(this->fd, this->buffers[next.buffer].data(), next.size);
+            } catch (...) {
+                failure = std::current_exception();
+            }
+
+            lock.lock();
+            this->writing = false;
+            this->free_buffers.push_back(next.buffer);
+            if (failure) {
+                // nothing after a failed write may reach the descriptor
+                if (!this->error)
+                    this->error = failure;
+                this->failed.store(true, std::memory_order_release);
+                for (const Full& dropped : this->full)
+                    this->free_buffers.push_back(dropped.buffer);
+                this->full.clear();
+            }
+            this->written.notify_all();
+        }
+    }
+
+    inline void check() {
+        if (this->failed.load(std::memory_order_acquire))
+            std::rethrow_exception(this->error);
+    }
+
+    // queues the current buffer and takes a free one, waiting while every buffer is queued
+    inline void rotate() {
+        std::unique_lock lock(this->mutex);
+        this->check();
+        this->full.push_back({ this->current, this->filled });
+        this->filled = 0;
+        this->queued.notify_one();
+        this->written.wait(lock, [&] { return !this->free_buffers.empty() || this->error; });
+        this->current = this->free_buffers.back();
+        this->free_buffers.pop_back();
+        this->check();
+    }
+
+    inline void write(const std::uint8_t* data, std::size_t size) {
+        this->check();
+        while (size) {
+            const std::size_t count = std::min(size, this->buffers[this->current].size() - this->filled);
+            std::copy_n(data, count, this->buffers[this->current].data() + this->filled);
+            this->filled += count;
+            data += count;
+            size -= count;
+            if (this->filled == this->buffers[this->current].size())
+                this->rotate();
+        }
+    }
+
+
+public:
+    explicit BackgroundFileStream(int fd, std::size_t buffer_size = 1024 * 1024, std::size_t buffers = 2)
+        : fd(fd)
+    {
+        if (this->fd < 0)
+            throw std::invalid_argument("invalid file descriptor");
+        if (buffer_size == 0 || buffers < 2)
+            throw std::invalid_argument("need at least 2 buffers of a positive size");
+        this->buffers.assign(buffers, std::vector<std::uint8_t>(buffer_size));
+        for (std::size_t b = buffers; b-- > 1;)
+            this->free_buffers.push_back(b);
+        this->writer = std::thread([this] { this->work(); });
+    }
+
+    // flushes and stops the writer thread, errors are lost here so call flush() to observe them
+    ~BackgroundFileStream() {
+        try {
+            this->flush();
+        } catch (...) {}
+        {
+            std::lock_guard lock(this->mutex);
+            this->stopping = true;
+        }
+        this->queued.notify_one();
+        this->writer.join();
+    }
+
+    BackgroundFileStream(const BackgroundFileStream& o) = delete;
+    BackgroundFileStream& operator=(const BackgroundFileStream& o) = delete;
+    BackgroundFileStream(BackgroundFileStream&& o) = delete;
+    BackgroundFileStream& operator=(BackgroundFileStream&& o) = delete;
+
+    // queues the partial buffer and waits until everything is written
+    inline void flush() {
+        if (this->filled)
+            this->rotate();
+        std::unique_lock lock(this->mutex);
+        this->written.wait(lock, [&] { return (this->full.empty() && !this->writing) || this->error; });
+        this->check();
+    }
+};
+
+}
@@ -0,0 +1,368 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "DataStream/DataStream.hpp"
+#include "DataStream/Encoding.hpp"
+
+
+
+
+namespace DataStream {
+
+struct Encoding {
+Encoding() = delete;
+Encoding(const Encoding& o) = delete;
+Encoding(Encoding&& o) noexcept = delete;
+Encoding& operator=(const Encoding& o) = delete;
+Encoding& operator=(Encoding&& o) noexcept = delete;
+~Encoding() = default;
+
+using Type = std::uint8_t;
+static const Type
+    Plain = 0, // values as written by operator<<
+    Varint = 1, // LEB128 of each value (zigzag for signed types), integers only
+    Delta = 2, // LEB128 of the zigzag difference to the previous value, integers only
+    BitPacked = 3, // minimum value + fixed width offsets from it, integers only
+    Dictionary = 4; // distinct values + fixed width codes into them
+};
+
+
+using ColumnTypes = std::tuple<
+    std::int8_t, std::uint8_t, std::int16_t, std::uint16_t,
+    std::int32_t, std::uint32_t, std::int64_t, std::uint64_t,
+    float, double
+>;
+
+template <typename T, std::size_t I = 0>
+inline constexpr std::size_t column_type_index() {
+    if constexpr (I == std::tuple_size_v<ColumnTypes>)
+        return I;
+    else if constexpr (std::is_same_v<T, std::tuple_element_t<I, ColumnTypes>>)
+        return I;
+    else
+        return column_type_index<T, I + 1>();
+}
+
+template <typename T>
+concept ColumnType = column_type_index<T>() < std::tuple_size_v<ColumnTypes>;
+
+// calls `f(std::type_identity<T>{})` with the column type stored under `type`
+template <typename F>
+inline void visit_column_type(std::uint8_t type, F&& f) {
+    bool found = [&]<std::size_t... I>(std::index_sequence<I...>) {
+        return ((type == I ? (f(std::type_identity<std::tuple_element_t<I, ColumnTypes>>{}), true) : false) || ...);
+    }(std::make_index_sequence<std::tuple_size_v<ColumnTypes>>{});
+    if (!found)
+        throw std::runtime_error("unknown column type");
+}
+
+
+template <ColumnType T>
+struct ColumnCodec {
+    using Bits =
+        std::conditional_t<sizeof(T) == 1, std::uint8_t,
+        std::conditional_t<sizeof(T) == 2, std::uint16_t,
+        std::conditional_t<sizeof(T) == 4, std::uint32_t,
+        std::uint64_t
+    >>>;
+
+    // state computed while sizing a column and reused while writing it
+    struct Plan {
+        std::size_t size = 0;
+        unsigned width = 0;
+        T minimum = 0;
+        std::vector<T> dictionary;
+        std::vector<std::uint32_t> codes;
+    };
+
+    static inline std::uint64_t widen(T value) {
+        if constexpr (std::is_signed_v<T>)
+            return static_cast<std::uint64_t>(static_cast<std::int64_t>(value));
+        else
+            return static_cast<std::uint64_t>(value);
+    }
+
+    static inline std::uint64_t unsigned_value(T value) {
+        if constexpr (std::is_signed_v<T>)
+            return DataStream::zigzag(value);
+        else
+            return value;
+    }
+
+    static inline T signed_value(std::uint64_t value) {
+        if constexpr (std::is_signed_v<T>)
+            return static_cast<T>(DataStream::unzigzag(value));
+        else
+            return static_cast<T>(value);
+    }
+
+    static inline Plan plan(std::span<const T> values, Encoding::Type encoding) {
+        if (encoding != Encoding::Plain && encoding != Encoding::Dictionary && !std::is_integral_v<T>)
+            throw std::invalid_argument("encoding requires an integer column");
+
+        Plan plan;
+        if (encoding == Encoding::Plain) {
+            plan.size = values.size_bytes();
+        } else if constexpr (std::is_integral_v<T>) {
+            if (encoding == Encoding::Varint) {
+                for (T value : values)
+                    plan.size += DataStream::varint_size(unsigned_value(value));
+            } else if (encoding == Encoding::Delta) {
+                std::uint64_t previous = 0;
+                for (T value : values) {
+                    plan.size += DataStream::varint_size(DataStream::zigzag(static_cast<std::int64_t>(widen(value) - previous)));
+                    previous = widen(value);
+                }
+            } else if (encoding == Encoding::BitPacked) {
+                if (!values.empty()) {
+                    auto [minimum, maximum] = std::minmax_element(values.begin(), values.end());
+                    plan.minimum = *minimum;
+                    plan.width = std::bit_width(widen(*maximum) - widen(*minimum));
+                }
+                plan.size = DataStream::varint_size(unsigned_value(plan.minimum)) + 1 + DataStream::bit_packed_size(values.size(), plan.width);
+            }
+        }
+
+        if (encoding == Encoding::Dictionary) {
+            std::unordered_map<Bits, std::uint32_t> codes;
+            plan.codes.reserve(values.size());
+            for (T value : values) {
+                auto [it, inserted] = codes.try_emplace(std::bit_cast<Bits>(value), static_cast<std::uint32_t>(plan.dictionary.size()));
+                if (inserted)
+                    plan.dictionary.push_back(value);
+                plan.codes.push_back(it->second);
+            }
+            plan.width = plan.dictionary.size() > 1 ? std::bit_width(plan.dictionary.size() - 1) : 0;
+            plan.size = DataStream::varint_size(plan.dictionary.size()) + plan.dictionary.size() * sizeof(T) + 1 + DataStream::bit_packed_size(values.size(), plan.width);
+        } else if (encoding > Encoding::Dictionary) {
+            throw std::invalid_argument("unknown encoding");
+        }
+        return plan;
+    }
+
+    template <typename S>
+    static inline void encode(S& stream, std::span<const T> values, Encoding::Type encoding, const Plan& plan) {
+        if (encoding == Encoding::Plain) {
+            stream << values;
+        } else if (encoding == Encoding::Dictionary) {
+            DataStream::write_varint(stream, plan.dictionary.size());
+            stream << std::span<const T>(plan.dictionary);
+            stream << static_cast<std::uint8_t>(plan.width);
+            DataStream::BitWriter<S> bits(stream);
+            for (std::uint32_t code : plan.codes)
+                bits.write(code, plan.width);
+            bits.flush();
+        } else if constexpr (std::is_integral_v<T>) {
+            if (encoding == Encoding::Varint) {
+                for (T value : values)
+                    DataStream::write_varint(stream, unsigned_value(value));
+            } else if (encoding == Encoding::Delta) {
+                std::uint64_t previous = 0;
+                for (T value : values) {
+                    DataStream::write_varint(stream, DataStream::zigzag(static_cast<std::int64_t>(widen(value) - previous)));
+                    previous = widen(value);
+                }
+            } else if (encoding == Encoding::BitPacked) {
+                DataStream::write_varint(stream, unsigned_value(plan.minimum));
+                stream << static_cast<std::uint8_t>(plan.width);
+                DataStream::BitWriter<S> bits(stream);
+                for (T value : values)
+                    bits.write(widen(value) - widen(plan.minimum), plan.width);
+                bits.flush();
+            }
+        }
+    }
+
+    template <typename S>
+    static inline void decode(S& stream, std::span<T> values, Encoding::Type encoding) {
+        if (encoding == Encoding::Plain) {
+            stream >> values;
+        } else if (encoding == Encoding::Dictionary) {
+            const std::uint64_t size = DataStream::read_varint(stream);
+            if (size > values.size()) // at most one entry per distinct value
+                throw std::runtime_error("invalid dictionary size");
+            std::vector<T> dictionary(size);
+            stream >> std::span<T>(dictionary);
+            std::uint8_t width;
+            stream >> width;
+            if (width > 32)
+                throw std::runtime_error("invalid dictionary code width");
+            DataStream::BitReader<S> bits(stream, DataStream::bit_packed_size(values.size(), width));
+            for (T& value : values) {
+                std::uint64_t code = bits.read(width);
+                if (code >= dictionary.size())
+                    throw std::out_of_range("dictionary code out of range");
+                value = dictionary[code];
+            }
+            bits.finish();
+        } else if constexpr (std::is_integral_v<T>) {
+            if (encoding == Encoding::Varint) {
+                for (T& value : values)
+                    value = signed_value(DataStream::read_varint(stream));
+            } else if (encoding == Encoding::Delta) {
+                std::uint64_t previous = 0;
+                for (T& value : values) {
+                    previous += static_cast<std::uint64_t>(DataStream::unzigzag(DataStream::read_varint(stream)));
+                    value = static_cast<T>(previous);
+                }
+            } else if (encoding == Encoding::BitPacked) {
+                std::uint64_t minimum = widen(signed_value(DataStream::read_varint(stream)));
+                std::uint8_t width;
+                stream >> width;
+                if (width > 64)
+                    throw std::runtime_error("invalid bit width");
+                DataStream::BitReader<S> bits(stream, DataStream::bit_packed_size(values.size(), width));
+                for (T& value : values)
+                    value = static_cast<T>(minimum + bits.read(width));
+                bits.finish();
+            } else {
+                throw std::runtime_error("unknown encoding");
+            }
+        } else {
+            throw std::runtime_error("encoding requires an integer column");
+        }
+    }
+};
+
+
+// collects columns of equal length and writes them as:
+//   uint64 rows, uint32 columns, { uint8 type, uint8 encoding, uint64 size } per column, encoded columns
+class ColumnarWriter {
+private:
+    std::size_t row_count;
+    std::vector<std::pair<std::uint8_t, Encoding::Type>> descriptors;
+    std::vector<std::size_t> sizes;
+    std::vector<const void*> values;
+    std::vector<std::shared_ptr<void>> plans;
+
+public:
+    explicit ColumnarWriter(std::size_t rows) : row_count(rows) {}
+    ColumnarWriter(const ColumnarWriter&) = delete;
+    ColumnarWriter& operator=(const ColumnarWriter&) = delete;
+    ~ColumnarWriter() = default;
+
+    // `values` must stay alive until write() returns
+    template <ColumnType T>
+    inline ColumnarWriter& column(std::span<const T> values, Encoding::Type encoding = Encoding::Plain) {
+        if (values.size() != this->row_count)
+            throw std::invalid_argument("column size does not match row count");
+
+        auto plan = std::make_shared<typename ColumnCodec<T>::Plan>(ColumnCodec<T>::plan(values, encoding));
+        this->descriptors.emplace_back(static_cast<std::uint8_t>(column_type_index<T>()), encoding);
+        this->sizes.push_back(plan->size);
+        this->values.push_back(values.data());
+        this->plans.push_back(std::move(plan));
+        return *this;
+    }
+
+    inline std::size_t rows() const { return this->row_count; }
+    inline std::size_t columns() const { return this->descriptors.size(); }
+
+    // exact number of bytes write() produces
+    inline std::size_t size() const {
+        std::size_t total = sizeof(std::uint64_t) + sizeof(std::uint32_t) + this->descriptors.size() * (2 + sizeof(std::uint64_t));
+        for (std::size_t size : this->sizes)
+            total += size;
+        return total;
+    }
+
+    template <typename S>
+    inline void write(S& stream) const {
+        stream << static_cast<std::uint64_t>(this->row_count) << static_cast<std::uint32_t>(this->descriptors.size());
+        for (std::size_t i = 0; i < this->descriptors.size(); ++i)
+            stream << this->descriptors[i].first << this->descriptors[i].second << static_cast<std::uint64_t>(this->sizes[i]);
+
+        for (std::size_t i = 0; i < this->descriptors.size(); ++i) {
+            DataStream::visit_column_type(this->descriptors[i].first, [&]<typename T>(std::type_identity<T>) {
+                ColumnCodec<T>::encode(
+                    stream,
+                    std::span<const T>(static_cast<const T*>(this->values[i]), this->row_count),
+                    this->descriptors[i].second,
+                    *static_cast<const typename ColumnCodec<T>::Plan*>(this->plans[i].get())
+                );
+            });
+        }
+    }
+};
+
+
+// reads the header written by ColumnarWriter and decodes only the requested columns,
+// columns have to be requested in ascending order, the ones in between are skipped
+template <typename S>
+class ColumnarReader {
+private:
+    struct Descriptor {
+        std::uint8_t type;
+        Encoding::Type encoding;
+        std::uint64_t size;
+    };
+
+    S& stream;
+    std::uint64_t row_count = 0;
+    std::vector<Descriptor> descriptors;
+    std::size_t next = 0; // column the stream is positioned at
+
+    inline void seek(std::size_t column) {
+        if (column >= this->descriptors.size())
+            throw std::out_of_range("column index out of range");
+        if (column < this->next)
+            throw std::logic_error("columns must be read in ascending order");
+        for (; this->next < column; ++this->next)
+            this->stream.skip(this->descriptors[this->next].size);
+    }
+
+public:
+    explicit ColumnarReader(S& stream) : stream(stream) {
+        std::uint32_t columns;
+        this->stream >> this->row_count >> columns;
+        // grown as descriptors are read, so a corrupt count runs out of input before it can allocate much
+        for (std::uint32_t i = 0; i < columns; ++i) {
+            Descriptor descriptor;
+            this->stream >> descriptor.type >> descriptor.encoding >> descriptor.size;
+            this->descriptors.push_back(descriptor);
+        }
+    }
+    ColumnarReader(const ColumnarReader&) = delete;
+    ColumnarReader& operator=(const ColumnarReader&) = delete;
+    ~ColumnarReader() = default;
+
+    inline std::size_t rows() const { return this->row_count; }
+    inline std::size_t columns() const { return this->descriptors.size(); }
+    inline Encoding::Type encoding(std::size_t column) const { return this->descriptors.at(column).encoding; }
+
+    template <ColumnType T>
+    inline bool holds(std::size_t column) const {
+        return this->descriptors.at(column).type == column_type_index<T>();
+    }
+
+    template <ColumnType T>
+    inline void read(std::size_t column, std::span<T> values) {
+        this->seek(column);
+        if (!this->holds<T>(column))
+            throw std::invalid_argument("column type mismatch");
+        if (values.size() != this->row_count)
+            throw std::invalid_argument("column size does not match row count");
+
+        ColumnCodec<T>::decode(this->stream, values, this->descriptors[column].encoding);
+        ++this->next;
+    }
+
+    // skips the columns that were not read, leaving the stream after the batch
+    inline void finish() {
+        for (; this->next < this->descriptors.size(); ++this->next)
+            this->stream.skip(this->descriptors[this->next].size);
+    }
+};
+
+}
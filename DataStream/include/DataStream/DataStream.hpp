@@ -1,10 +1,12 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
 #include <bit>
 #include <concepts>
 #include <cstdint>
 #include <fstream>
+#include <initializer_list>
 #include <iomanip>
 #include <span>
 #include <stdexcept>
@@ -13,6 +15,18 @@
 #include <type_traits>
 #include <utility>
 
+#if __has_include(<stdfloat>)
+#include <stdfloat>
+#endif
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h>
+#endif
+
+#if defined(__F16C__)
+#include <immintrin.h>
+#endif
+
 
 
 
@@ -39,6 +53,122 @@ inline constexpr T byteswap(T value) {
     return std::bit_cast<T>(swapped);
 }
 
+inline void prefetch(const void* address) {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(address, 0, 3);
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    _mm_prefetch(static_cast<const char*>(address), _MM_HINT_T0);
+#else
+    (void)address;
+#endif
+}
+
+
+// storage formats for Stream::write_as() / read_as(), the standard types when the compiler has them
+#if defined(__STDCPP_FLOAT16_T__)
+using float16_t = std::float16_t;
+#else
+struct float16_t { std::uint16_t bits; };
+#endif
+
+#if defined(__STDCPP_BFLOAT16_T__)
+using bfloat16_t = std::bfloat16_t;
+#else
+struct bfloat16_t { std::uint16_t bits; };
+#endif
+
+template <typename T>
+concept HalfFloat = std::is_same_v<T, DataStream::float16_t> || std::is_same_v<T, DataStream::bfloat16_t>;
+
+// IEEE binary16, round to nearest even, NaN becomes the canonical quiet NaN
+inline std::uint16_t float_to_half(float value) {
+    const std::uint32_t infinity = 255u << 23, overflow = (127u + 16) << 23;
+    const float denormal = std::bit_cast<float>(((127u - 15) + (23 - 10) + 1) << 23);
+
+    std::uint32_t x = std::bit_cast<std::uint32_t>(value);
+    const std::uint32_t sign = x & 0x80000000u;
+    x ^= sign;
+
+    std::uint16_t half;
+    if (x >= overflow) {
+        half = x > infinity ? 0x7E00 : 0x7C00;
+    } else if (x < (113u << 23)) {
+        // let the float addition do the rounding of the subnormal result
+        half = static_cast<std::uint16_t>(std::bit_cast<std::uint32_t>(std::bit_cast<float>(x) + denormal) - std::bit_cast<std::uint32_t>(denormal));
+    } else {
+        const std::uint32_t odd = (x >> 13) & 1;
+        x += ((15u - 127) << 23) + 0xFFF + odd;
+        half = static_cast<std::uint16_t>(x >> 13);
+    }
+    return half | static_cast<std::uint16_t>(sign >> 16);
+}
+
+inline float half_to_float(std::uint16_t half) {
+    const float magic = std::bit_cast<float>(113u << 23);
+    const std::uint32_t exponent_mask = 0x7C00u << 13;
+
+    std::uint32_t x = (half & 0x7FFFu) << 13;
+    const std::uint32_t exponent = x & exponent_mask;
+    x += (127u - 15) << 23;
+    if (exponent == exponent_mask)
+        x += (128u - 16) << 23;
+    else if (exponent == 0)
+        x = std::bit_cast<std::uint32_t>(std::bit_cast<float>(x + (1u << 23)) - magic);
+    return std::bit_cast<float>(x | (std::uint32_t(half & 0x8000u) << 16));
+}
+
+// upper half of the float bits, round to nearest even, NaN stays (quiet) NaN
+inline std::uint16_t float_to_bfloat16(float value) {
+    const std::uint32_t x = std::bit_cast<std::uint32_t>(value);
+    const bool nan = (x & 0x7FFFFFFFu) > 0x7F800000u;
+    const std::uint32_t rounded = x + 0x7FFFu + ((x >> 16) & 1);
+    return static_cast<std::uint16_t>(nan ? (x >> 16) | 0x40 : rounded >> 16);
+}
+
+inline float bfloat16_to_float(std::uint16_t value) {
+    return std::bit_cast<float>(std::uint32_t(value) << 16);
+}
+
+template <HalfFloat U>
+inline void narrow(std::span<const float> values, std::uint16_t* output) {
+    std::size_t i = 0;
+    if constexpr (std::is_same_v<U, DataStream::float16_t>) {
+#if defined(__F16C__)
+        for (; i + 8 <= values.size(); i += 8)
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i), _mm256_cvtps_ph(_mm256_loadu_ps(values.data() + i), _MM_FROUND_TO_NEAREST_INT));
+#endif
+        for (; i < values.size(); ++i)
+            output[i] = DataStream::float_to_half(values[i]);
+    } else {
+        for (; i < values.size(); ++i)
+            output[i] = DataStream::float_to_bfloat16(values[i]);
+    }
+}
+
+template <HalfFloat U>
+inline void widen(const std::uint16_t* input, std::span<float> values) {
+    std::size_t i = 0;
+    if constexpr (std::is_same_v<U, DataStream::float16_t>) {
+#if defined(__F16C__)
+        for (; i + 8 <= values.size(); i += 8)
+            _mm256_storeu_ps(values.data() + i, _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i))));
+#endif
+        for (; i < values.size(); ++i)
+            values[i] = DataStream::half_to_float(input[i]);
+    } else {
+        for (; i < values.size(); ++i)
+            values[i] = DataStream::bfloat16_to_float(input[i]);
+    }
+}
+
+
+// reserved field of a stream, filled in later with Stream::fill()
+template <typename T>
+requires std::is_arithmetic_v<T>
+struct Placeholder {
+    std::size_t position = 0; // byte offset in the buffer or file, so it stays valid if the storage moves
+};
+
 
 struct Mode {
 Mode() = delete;
@@ -51,7 +181,8 @@ Mode& operator=(Mode&& o) noexcept = delete;
 using Type = std::uint8_t;
 static const Type
     Input = 0b00000001, // take deserialized data from the stream into the program (input to program)
-    Output = 0b00000010; // put serialized data to the stream from the prgram (output to stream)
+    Output = 0b00000010, // put serialized data to the stream from the prgram (output to stream)
+    Count = 0b00000100; // only with Output, advances the index without storing anything (see SizeCounter)
 };
 
 
@@ -60,11 +191,21 @@ template <
     std::endian endiannes = std::endian::native
 >
 class Stream {
+    static_assert(!(mode & DataStream::Mode::Count) || mode == (DataStream::Mode::Output | DataStream::Mode::Count),
+        "Mode::Count can only be combined with Mode::Output");
+
 private:
     std::span<std::uint8_t> data;
     std::uint8_t* underlying_data = nullptr;
     std::fstream* file_stream = nullptr;
     std::size_t index = 0;
+    std::size_t prefetch_distance = 0;
+    std::size_t extent = 0; // end of the furthest set() of a counting stream
+
+    static constexpr bool counting = (mode & DataStream::Mode::Count) == DataStream::Mode::Count;
+
+    static constexpr std::size_t batch_prefetch_distance = 16; // number of offsets looked ahead by get_many()
+    static constexpr std::size_t column_block_size = 256; // records transposed per pass by write_columns()/read_columns()
 
     template <typename T>
     requires std::is_floating_point_v<T> || std::is_integral_v<T>
@@ -75,6 +216,11 @@ private:
     inline void write(std::span<const std::uint8_t> data)
     requires ((mode & DataStream::Mode::Output) == DataStream::Mode::Output)
     {
+        if constexpr (counting) {
+            this->index += data.size();
+            return;
+        }
+
         if (this->file_stream) {
             this->file_stream->write(reinterpret_cast<const char*>(data.data()), data.size());
             if (!*this->file_stream)
@@ -97,11 +243,48 @@ private:
         } else {
             if (this->index + data.size() > this->data.size())
                 throw std::out_of_range("index out of range");
+            if (this->prefetch_distance && this->index + this->prefetch_distance < this->data.size())
+                DataStream::prefetch(this->underlying_data + this->index + this->prefetch_distance);
             std::copy_n(this->underlying_data + this->index, data.size(), data.data());
             this->index += data.size();
         }
     }
 
+    // unchecked stores/loads, callers validate the index range first
+    template <typename T>
+    inline void store(const T& value, std::size_t start_index) {
+        T output = this->byteswap(value);
+        std::copy_n(reinterpret_cast<const std::uint8_t*>(&output), sizeof(T), this->underlying_data + start_index);
+    }
+
+    template <typename T>
+    inline T load(std::size_t start_index) const {
+        T value;
+        std::copy_n(this->underlying_data + start_index, sizeof(T), reinterpret_cast<std::uint8_t*>(&value));
+        return this->byteswap(value);
+    }
+
+    template <typename T>
+    inline void check_many(std::size_t count, std::span<const std::size_t> start_indices) const {
+        if (count != start_indices.size())
+            throw std::invalid_argument("values and start indices size mismatch");
+        if (start_indices.empty())
+            return;
+        const std::size_t last = *std::max_element(start_indices.begin(), start_indices.end());
+        if (sizeof(T) > this->data.size() || last > this->data.size() - sizeof(T))
+            throw std::out_of_range("start index out of range");
+    }
+
+    template <typename T>
+    inline void check_strided(std::size_t count, std::size_t start_index, std::size_t stride) const {
+        if (count == 0)
+            return;
+        if (sizeof(T) > this->data.size() || start_index > this->data.size() - sizeof(T))
+            throw std::out_of_range("start index out of range");
+        if (stride != 0 && (count - 1) > (this->data.size() - sizeof(T) - start_index) / stride)
+            throw std::out_of_range("strided range out of range");
+    }
+
 
 public:
     template <typename Container>
@@ -111,7 +294,7 @@ public:
         underlying_data(this->data.data())
     {}
 
-    template <std::std::size_t N>
+    template <std::size_t N>
     Stream(std::uint8_t (&array)[N])
         : data(array, N),
         underlying_data(this->data.data())
@@ -124,13 +307,19 @@ public:
             throw std::ios_base::failure("file stream not open");
     }
 
+    Stream()
+    requires ((mode & DataStream::Mode::Count) == DataStream::Mode::Count)
+    {}
+
     ~Stream() = default;
 
     Stream(const Stream& o)
         : data(o.data),
         underlying_data(o.underlying_data),
         file_stream(o.file_stream),
-        index(o.index)
+        index(o.index),
+        prefetch_distance(o.prefetch_distance),
+        extent(o.extent)
     {}
 
     Stream& operator=(const Stream& o) {
@@ -139,6 +328,8 @@ public:
         underlying_data = o.underlying_data;
         file_stream = o.file_stream;
         index = o.index;
+        prefetch_distance = o.prefetch_distance;
+        extent = o.extent;
         return *this;
     }
 
@@ -146,7 +337,9 @@ public:
         : data(std::exchange(o.data, {})),
         underlying_data(std::exchange(o.underlying_data, nullptr)),
         file_stream(std::exchange(o.file_stream, nullptr)),
-        index(std::exchange(o.index, 0))
+        index(std::exchange(o.index, 0)),
+        prefetch_distance(std::exchange(o.prefetch_distance, 0)),
+        extent(std::exchange(o.extent, 0))
     {}
 
     Stream& operator=(Stream&& o) noexcept {
@@ -155,13 +348,15 @@ public:
         underlying_data = std::exchange(o.underlying_data, nullptr);
         file_stream = std::exchange(o.file_stream, nullptr);
         index = std::exchange(o.index, 0);
+        prefetch_distance = std::exchange(o.prefetch_distance, 0);
+        extent = std::exchange(o.extent, 0);
         return *this;
     }
 
     template <typename T>
     requires std::is_arithmetic_v<T>
     Stream& operator<<(const T& value)
-    requires (mode == DataStream::Mode::Output)
+    requires ((mode & ~DataStream::Mode::Count) == DataStream::Mode::Output)
     {
         T output = this->byteswap(value);
         this->write(std::span<const std::uint8_t>(reinterpret_cast<const std::uint8_t*>(&output), sizeof(T)));
@@ -178,18 +373,215 @@ public:
         return *this;
     }
 
+    template <typename T>
+    requires std::is_arithmetic_v<T>
+    Stream& operator<<(std::span<const T> values)
+    requires ((mode & ~DataStream::Mode::Count) == DataStream::Mode::Output)
+    {
+        if constexpr (counting || endiannes == std::endian::native || sizeof(T) == 1) {
+            this->write(std::span<const std::uint8_t>(reinterpret_cast<const std::uint8_t*>(values.data()), values.size_bytes()));
+        } else if (this->file_stream) {
+            for (const T& value : values)
+                *this << value;
+        } else {
+            if (this->index + values.size_bytes() > this->data.size())
+                throw std::out_of_range("index out of range");
+            for (std::size_t i = 0; i < values.size(); ++i)
+                this->store(values[i], this->index + i * sizeof(T));
+            this->index += values.size_bytes();
+        }
+        return *this;
+    }
+
+    template <typename T>
+    requires std::is_arithmetic_v<T>
+    Stream& operator>>(std::span<T> values)
+    requires (mode == DataStream::Mode::Input)
+    {
+        if constexpr (endiannes == std::endian::native || sizeof(T) == 1) {
+            this->read(std::span<std::uint8_t>(reinterpret_cast<std::uint8_t*>(values.data()), values.size_bytes()));
+        } else if (this->file_stream) {
+            for (T& value : values)
+                *this >> value;
+        } else {
+            if (this->index + values.size_bytes() > this->data.size())
+                throw std::out_of_range("index out of range");
+            for (std::size_t i = 0; i < values.size(); ++i)
+                values[i] = this->load<T>(this->index + i * sizeof(T));
+            this->index += values.size_bytes();
+        }
+        return *this;
+    }
+
+    // narrows every float to the 16 bit format U and writes it like operator<< would write a U
+    template <DataStream::HalfFloat U>
+    Stream& write_as(std::span<const float> values)
+    requires ((mode & ~DataStream::Mode::Count) == DataStream::Mode::Output)
+    {
+        if constexpr (counting) {
+            this->index += values.size() * sizeof(std::uint16_t);
+            return *this;
+        }
+
+        std::array<std::uint16_t, 512> chunk;
+        for (std::size_t i = 0; i < values.size(); i += chunk.size()) {
+            const std::size_t count = std::min(chunk.size(), values.size() - i);
+            DataStream::narrow<U>(values.subspan(i, count), chunk.data());
+            *this << std::span<const std::uint16_t>(chunk.data(), count);
+        }
+        return *this;
+    }
+
+    template <DataStream::HalfFloat U>
+    Stream& read_as(std::span<float> values)
+    requires (mode == DataStream::Mode::Input)
+    {
+        std::array<std::uint16_t, 512> chunk;
+        for (std::size_t i = 0; i < values.size(); i += chunk.size()) {
+            const std::size_t count = std::min(chunk.size(), values.size() - i);
+            *this >> std::span<std::uint16_t>(chunk.data(), count);
+            DataStream::widen<U>(chunk.data(), values.subspan(i, count));
+        }
+        return *this;
+    }
+
+    // fills each destination in order with the next bytes of the stream
+    inline Stream& read_into(std::span<const std::span<std::uint8_t>> destinations)
+    requires (mode == DataStream::Mode::Input)
+    {
+        for (std::span<std::uint8_t> destination : destinations)
+            this->read(destination);
+        return *this;
+    }
+
+    inline Stream& read_into(std::initializer_list<std::span<std::uint8_t>> destinations)
+    requires (mode == DataStream::Mode::Input)
+    {
+        return this->read_into(std::span<const std::span<std::uint8_t>>(destinations.begin(), destinations.size()));
+    }
+
+    inline void skip(std::size_t count)
+    requires ((mode & DataStream::Mode::Input) == DataStream::Mode::Input)
+    {
+        if (this->file_stream) {
+            this->file_stream->seekg(static_cast<std::streamoff>(count), std::ios::cur);
+            if (!*this->file_stream)
+                throw std::ios_base::failure("file seek failed");
+        } else {
+            if (this->index + count > this->data.size())
+                throw std::out_of_range("index out of range");
+            this->index += count;
+        }
+    }
+
     template <typename T>
     requires std::is_arithmetic_v<T>
     inline void set(const T& value, std::size_t start_index)
     requires ((mode & DataStream::Mode::Output) == DataStream::Mode::Output)
     {
-        if (this->file_stream)
-            throw std::logic_error("set() not supported with file stream");
+        if (this->file_stream) {
+            // seeks to the field and back, see DescriptorStream for positional writes without a shared position
+            const std::streampos position = this->file_stream->tellp();
+            const T output = this->byteswap(value);
+            this->file_stream->seekp(static_cast<std::streamoff>(start_index));
+            this->file_stream->write(reinterpret_cast<const char*>(&output), sizeof(T));
+            this->file_stream->seekp(position);
+            if (!*this->file_stream)
+                throw std::ios_base::failure("file write failed");
+            return;
+        }
+
+        if constexpr (counting) {
+            this->extent = std::max(this->extent, start_index + sizeof(T));
+            return;
+        }
 
-        T output = this->byteswap(value);
         if (start_index + sizeof(T) > this->data.size())
             throw std::out_of_range("start index out of range");
-        std::copy_n(reinterpret_cast<const std::uint8_t*>(&output), sizeof(T), this->underlying_data + start_index);
+        this->store(value, start_index);
+    }
+
+    // reserves a zeroed T at the write position, the value is written later with fill()
+    template <typename T>
+    requires std::is_arithmetic_v<T>
+    inline DataStream::Placeholder<T> placeholder()
+    requires ((mode & DataStream::Mode::Output) == DataStream::Mode::Output)
+    {
+        DataStream::Placeholder<T> placeholder;
+        if (this->file_stream) {
+            const std::streampos position = this->file_stream->tellp();
+            if (position == std::streampos(-1))
+                throw std::ios_base::failure("file stream position unavailable");
+            placeholder.position = static_cast<std::size_t>(position);
+        } else {
+            placeholder.position = this->index;
+        }
+        const T zero{};
+        this->write(std::span<const std::uint8_t>(reinterpret_cast<const std::uint8_t*>(&zero), sizeof(T)));
+        return placeholder;
+    }
+
+    // writes `value` into a reserved field, file streams seek back to it and return to the write position
+    template <typename T>
+    requires std::is_arithmetic_v<T>
+    inline void fill(const DataStream::Placeholder<T>& placeholder, const T& value)
+    requires ((mode & DataStream::Mode::Output) == DataStream::Mode::Output)
+    {
+        this->set(value, placeholder.position);
+    }
+
+    template <typename T>
+    requires std::is_arithmetic_v<T>
+    inline void set_many(std::span<const T> values, std::span<const std::size_t> start_indices)
+    requires ((mode & DataStream::Mode::Output) == DataStream::Mode::Output)
+    {
+        if (this->file_stream)
+            throw std::logic_error("set_many() not supported with file stream");
+        if constexpr (counting) {
+            if (values.size() != start_indices.size())
+                throw std::invalid_argument("values and start indices size mismatch");
+            if (!start_indices.empty())
+                this->extent = std::max(this->extent, *std::max_element(start_indices.begin(), start_indices.end()) + sizeof(T));
+            return;
+        }
+        this->check_many<T>(values.size(), start_indices);
+
+        const std::size_t count = start_indices.size();
+        std::size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            this->store(values[i], start_indices[i]);
+            this->store(values[i + 1], start_indices[i + 1]);
+            this->store(values[i + 2], start_indices[i + 2]);
+            this->store(values[i + 3], start_indices[i + 3]);
+        }
+        for (; i < count; ++i)
+            this->store(values[i], start_indices[i]);
+    }
+
+    template <typename T>
+    requires std::is_arithmetic_v<T>
+    inline void set_strided(std::span<const T> values, std::size_t start_index, std::size_t stride)
+    requires ((mode & DataStream::Mode::Output) == DataStream::Mode::Output)
+    {
+        if (this->file_stream)
+            throw std::logic_error("set_strided() not supported with file stream");
+        if constexpr (counting) {
+            if (!values.empty())
+                this->extent = std::max(this->extent, start_index + (values.size() - 1) * stride + sizeof(T));
+            return;
+        }
+        this->check_strided<T>(values.size(), start_index, stride);
+
+        const std::size_t count = values.size();
+        std::size_t i = 0;
+        for (; i + 4 <= count; i += 4, start_index += 4 * stride) {
+            this->store(values[i], start_index);
+            this->store(values[i + 1], start_index + stride);
+            this->store(values[i + 2], start_index + 2 * stride);
+            this->store(values[i + 3], start_index + 3 * stride);
+        }
+        for (; i < count; ++i, start_index += stride)
+            this->store(values[i], start_index);
     }
 
     template <typename T>
@@ -197,13 +589,155 @@ public:
     inline void get(T& value, std::size_t start_index) const
     requires ((mode & DataStream::Mode::Input) == DataStream::Mode::Input)
     {
-        if (this->file_stream)
-            throw std::logic_error("get() not supported with file stream");
+        if (this->file_stream) {
+            const std::streampos position = this->file_stream->tellg();
+            this->file_stream->seekg(static_cast<std::streamoff>(start_index));
+            this->file_stream->read(reinterpret_cast<char*>(&value), sizeof(T));
+            this->file_stream->seekg(position);
+            if (!*this->file_stream)
+                throw std::ios_base::failure("file read failed");
+            value = this->byteswap(value);
+            return;
+        }
 
         if (start_index + sizeof(T) > this->data.size())
             throw std::out_of_range("start index out of range");
-        std::copy_n(this->underlying_data + start_index, sizeof(T), reinterpret_cast<std::uint8_t*>(&value));
-        value = byteswap(value);
+        value = this->load<T>(start_index);
+    }
+
+    template <typename T>
+    requires std::is_arithmetic_v<T>
+    inline void get_many(std::span<T> values, std::span<const std::size_t> start_indices) const
+    requires ((mode & DataStream::Mode::Input) == DataStream::Mode::Input)
+    {
+        if (this->file_stream)
+            throw std::logic_error("get_many() not supported with file stream");
+        this->check_many<T>(values.size(), start_indices);
+
+        const std::size_t count = start_indices.size();
+        const std::size_t ahead = std::min(batch_prefetch_distance, count);
+        for (std::size_t i = 0; i < ahead; ++i)
+            DataStream::prefetch(this->underlying_data + start_indices[i]);
+
+        std::size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            for (std::size_t j = i + ahead; j < std::min(i + ahead + 4, count); ++j)
+                DataStream::prefetch(this->underlying_data + start_indices[j]);
+            values[i] = this->load<T>(start_indices[i]);
+            values[i + 1] = this->load<T>(start_indices[i + 1]);
+            values[i + 2] = this->load<T>(start_indices[i + 2]);
+            values[i + 3] = this->load<T>(start_indices[i + 3]);
+        }
+        for (; i < count; ++i)
+            values[i] = this->load<T>(start_indices[i]);
+    }
+
+    template <typename T>
+    requires std::is_arithmetic_v<T>
+    inline void get_strided(std::span<T> values, std::size_t start_index, std::size_t stride) const
+    requires ((mode & DataStream::Mode::Input) == DataStream::Mode::Input)
+    {
+        if (this->file_stream)
+            throw std::logic_error("get_strided() not supported with file stream");
+        this->check_strided<T>(values.size(), start_index, stride);
+
+        const std::size_t count = values.size();
+        std::size_t i = 0;
+        for (; i + 4 <= count; i += 4, start_index += 4 * stride) {
+            values[i] = this->load<T>(start_index);
+            values[i + 1] = this->load<T>(start_index + stride);
+            values[i + 2] = this->load<T>(start_index + 2 * stride);
+            values[i + 3] = this->load<T>(start_index + 3 * stride);
+        }
+        for (; i < count; ++i, start_index += stride)
+            values[i] = this->load<T>(start_index);
+    }
+
+    // writes each field of the records as a contiguous column, in the order the fields are given
+    template <typename Record, typename... T>
+    requires (sizeof...(T) > 0 && (std::is_arithmetic_v<T> && ...))
+    Stream& write_columns(std::span<const Record> records, T Record::*... fields)
+    requires ((mode & ~DataStream::Mode::Count) == DataStream::Mode::Output)
+    {
+        const std::size_t count = records.size();
+        if (this->file_stream) {
+            auto column = [&]<typename F>(F Record::* field) {
+                for (std::size_t i = 0; i < count; ++i)
+                    *this << records[i].*field;
+            };
+            (column(fields), ...);
+            return *this;
+        }
+
+        const std::size_t total = count * (sizeof(T) + ...);
+        if constexpr (counting) {
+            this->index += total;
+            return *this;
+        }
+        if (this->index + total > this->data.size())
+            throw std::out_of_range("index out of range");
+
+        // transpose in blocks so the records stay cache resident while every column is filled
+        for (std::size_t block = 0; block < count; block += column_block_size) {
+            const std::size_t end = std::min(block + column_block_size, count);
+            std::size_t start_index = this->index;
+            auto column = [&]<typename F>(F Record::* field) {
+                for (std::size_t i = block; i < end; ++i)
+                    this->store(records[i].*field, start_index + i * sizeof(F));
+                start_index += count * sizeof(F);
+            };
+            (column(fields), ...);
+        }
+        this->index += total;
+        return *this;
+    }
+
+    // reads columns written by write_columns() back into the fields of the records
+    template <typename Record, typename... T>
+    requires (sizeof...(T) > 0 && (std::is_arithmetic_v<T> && ...))
+    Stream& read_columns(std::span<Record> records, T Record::*... fields)
+    requires (mode == DataStream::Mode::Input)
+    {
+        const std::size_t count = records.size();
+        if (this->file_stream) {
+            auto column = [&]<typename F>(F Record::* field) {
+                for (std::size_t i = 0; i < count; ++i)
+                    *this >> records[i].*field;
+            };
+            (column(fields), ...);
+            return *this;
+        }
+
+        const std::size_t total = count * (sizeof(T) + ...);
+        if (this->index + total > this->data.size())
+            throw std::out_of_range("index out of range");
+
+        for (std::size_t block = 0; block < count; block += column_block_size) {
+            const std::size_t end = std::min(block + column_block_size, count);
+            std::size_t start_index = this->index;
+            auto column = [&]<typename F>(F Record::* field) {
+                for (std::size_t i = block; i < end; ++i)
+                    records[i].*field = this->load<F>(start_index + i * sizeof(F));
+                start_index += count * sizeof(F);
+            };
+            (column(fields), ...);
+        }
+        this->index += total;
+        return *this;
+    }
+
+    // prefetch `distance` bytes ahead of the read position on sequential reads (0 disables)
+    inline void prefetch(std::size_t distance)
+    requires ((mode & DataStream::Mode::Input) == DataStream::Mode::Input)
+    {
+        this->prefetch_distance = distance;
+    }
+
+    // bytes a stream of the same layout needs to hold everything written so far
+    inline std::size_t size() const
+    requires ((mode & DataStream::Mode::Count) == DataStream::Mode::Count)
+    {
+        return std::max(this->index, this->extent);
     }
 
     inline const std::uint8_t* get() const {
@@ -218,11 +752,17 @@ public:
 
         std::ostringstream oss;
         oss << std::hex << std::uppercase << std::setfill('0');
-        for (std::size_t i = 0; i < length; ++i)
-            oss << std::setw(2) << static_cast<std::uint16_t>(this->underlying_data[i]) << (i == length - 1 ? "" : delimeter);
-        std::cout << std::dec << std::nouppercase << std::setfill(' ');
+        for (std::size_t i = 0; i < this->data.size(); ++i)
+            oss << std::setw(2) << static_cast<std::uint16_t>(this->underlying_data[i]) << (i == this->data.size() - 1 ? "" : delimeter);
+        oss << std::dec << std::nouppercase << std::setfill(' ');
         return oss.str();
     }
 };
 
+
+// runs the serialization code path of an output stream without storing anything,
+// to size a buffer exactly before serializing into it
+template <std::endian endiannes = std::endian::native>
+using SizeCounter = DataStream::Stream<DataStream::Mode::Output | DataStream::Mode::Count, endiannes>;
+
 }
@@ -0,0 +1,524 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <initializer_list>
+#include <ios>
+#include <memory>
+#include <new>
+#include <span>
+#include <stdexcept>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <climits>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "DataStream/DataStream.hpp"
+
+
+
+
+namespace DataStream {
+
+inline std::ios_base::failure io_error(const char* message, int error = errno) {
+    return std::ios_base::failure(message, std::error_code(error, std::generic_category()));
+}
+
+struct AlignedDelete {
+    inline void operator()(std::uint8_t* memory) const { std::free(memory); }
+};
+
+using AlignedBuffer = std::unique_ptr<std::uint8_t, DataStream::AlignedDelete>;
+
+// `size` is rounded up to a multiple of `alignment`, a power of two
+inline DataStream::AlignedBuffer aligned_buffer(std::size_t alignment, std::size_t size) {
+    size = (size + alignment - 1) / alignment * alignment;
+    DataStream::AlignedBuffer buffer(static_cast<std::uint8_t*>(std::aligned_alloc(alignment, size)));
+    if (!buffer)
+        throw std::bad_alloc();
+    return buffer;
+}
+
+// pwrite() until everything is written, retrying partial writes and EINTR
+inline void pwrite_all(int fd, const std::uint8_t* data, std::size_t size, std::size_t offset) {
+    while (size) {
+        const ssize_t written = ::pwrite(fd, data, size, static_cast<off_t>(offset));
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            throw DataStream::io_error("file write failed");
+        }
+        data += written;
+        size -= written;
+        offset += written;
+    }
+}
+
+// one write(), retrying EINTR, returns the number of bytes written
+inline std::size_t write_some(int fd, const std::uint8_t* data, std::size_t size) {
+    for (;;) {
+        const ssize_t written = ::write(fd, data, size);
+        if (written >= 0)
+            return static_cast<std::size_t>(written);
+        if (errno != EINTR)
+            throw DataStream::io_error("file write failed");
+    }
+}
+
+// write() until everything is written, retrying partial writes and EINTR
+inline void write_all(int fd, const std::uint8_t* data, std::size_t size) {
+    while (size) {
+        const std::size_t written = DataStream::write_some(fd, data, size);
+        data += written;
+        size -= written;
+    }
+}
+
+#ifdef IOV_MAX
+inline constexpr std::size_t iov_max = IOV_MAX;
+#else
+inline constexpr std::size_t iov_max = 1024;
+#endif
+
+// drops the first `size` bytes of an iovec array
+inline void advance(struct iovec*& buffers, std::size_t& count, std::size_t size) {
+    while (count && size >= buffers->iov_len) {
+        size -= buffers->iov_len;
+        ++buffers;
+        --count;
+    }
+    if (count) {
+        buffers->iov_base = static_cast<std::uint8_t*>(buffers->iov_base) + size;
+        buffers->iov_len -= size;
+    }
+}
+
+// writev() until every buffer is written, in batches of at most IOV_MAX buffers, retrying partial writes
+// and EINTR, the iovec array is consumed, on failure `buffers` and `count` describe what was not written
+inline void writev_all(int fd, struct iovec*& buffers, std::size_t& count) {
+    while (count) {
+        const ssize_t written = ::writev(fd, buffers, static_cast<int>(std::min(count, DataStream::iov_max)));
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            throw DataStream::io_error("file write failed");
+        }
+        DataStream::advance(buffers, count, static_cast<std::size_t>(written));
+    }
+}
+
+// one read(), retrying EINTR, returns 0 at the end of the file
+inline std::size_t read_some(int fd, std::uint8_t* data, std::size_t size) {
+    for (;;) {
+        const ssize_t read = ::read(fd, data, size);
+        if (read >= 0)
+            return static_cast<std::size_t>(read);
+        if (errno != EINTR)
+            throw DataStream::io_error("file read failed");
+    }
+}
+
+// pread() until `size` bytes are read, reaching the end of the file first is an error
+inline void pread_all(int fd, std::uint8_t* data, std::size_t size, std::size_t offset) {
+    while (size) {
+        const ssize_t read = ::pread(fd, data, size, static_cast<off_t>(offset));
+        if (read < 0) {
+            if (errno == EINTR)
+                continue;
+            throw DataStream::io_error("file read failed");
+        }
+        if (read == 0)
+            throw std::ios_base::failure("file read failed, unexpected end of file");
+        data += read;
+        size -= read;
+        offset += read;
+    }
+}
+
+
+// operator<< and operator>> of the streams built on write()/read() of raw bytes, `Derived` provides
+// write(const std::uint8_t*, std::size_t) when `output` and read(std::uint8_t*, std::size_t) when `input`
+// and befriends this class when they are private
+template <typename Derived, std::endian endiannes, bool output, bool input>
+class StreamOperators {
+protected:
+    template <typename T>
+    requires std::is_floating_point_v<T> || std::is_integral_v<T>
+    static inline constexpr T byteswap(T value) {
+        return endiannes != std::endian::native ? DataStream::byteswap(value) : value;
+    }
+
+
+public:
+    template <typename T>
+    requires std::is_arithmetic_v<T>
+    Derived& operator<<(const T& value)
+    requires (output)
+    {
+        const T swapped = StreamOperators::byteswap(value);
+        static_cast<Derived*>(this)->write(reinterpret_cast<const std::uint8_t*>(&swapped), sizeof(T));
+        return static_cast<Derived&>(*this);
+    }
+
+    template <typename T>
+    requires std::is_arithmetic_v<T>
+    Derived& operator>>(T& value)
+    requires (input)
+    {
+        static_cast<Derived*>(this)->read(reinterpret_cast<std::uint8_t*>(&value), sizeof(T));
+        value = StreamOperators::byteswap(value);
+        return static_cast<Derived&>(*this);
+    }
+
+    template <typename T>
+    requires std::is_arithmetic_v<T>
+    Derived& operator<<(std::span<const T> values)
+    requires (output)
+    {
+        if constexpr (endiannes == std::endian::native || sizeof(T) == 1) {
+            static_cast<Derived*>(this)->write(reinterpret_cast<const std::uint8_t*>(values.data()), values.size_bytes());
+        } else {
+            for (const T& value : values)
+                *this << value;
+        }
+        return static_cast<Derived&>(*this);
+    }
+
+    template <typename T>
+    requires std::is_arithmetic_v<T>
+    Derived& operator>>(std::span<T> values)
+    requires (input)
+    {
+        static_cast<Derived*>(this)->read(reinterpret_cast<std::uint8_t*>(values.data()), values.size_bytes());
+        if constexpr (endiannes != std::endian::native && sizeof(T) != 1)
+            for (T& value : values)
+                value = StreamOperators::byteswap(value);
+        return static_cast<Derived&>(*this);
+    }
+};
+
+
+// stream over a POSIX file descriptor (file, pipe or socket), the descriptor is not owned and is not closed
+//
+// operator<< and operator>> go through the stream's own buffer with plain write()/read() calls, values
+// larger than the buffer bypass it, written data reaches the descriptor on flush() or destruction,
+// append_ref() queues external bytes without copying them, they are written with the buffer by writev(),
+// read_into() reads straight into the destination buffers with readv()
+//
+// set()/get() use pwrite()/pread(), they do not move a shared file position so concurrent get()s
+// on one descriptor are safe, set()s can be coalesced in a write combining buffer (see combine())
+template <
+    DataStream::Mode::Type mode = (DataStream::Mode::Input | DataStream::Mode::Output),
+    std::endian endiannes = std::endian::native
+>
+class DescriptorStream : public DataStream::StreamOperators<DescriptorStream<mode, endiannes>, endiannes, mode == DataStream::Mode::Output, mode == DataStream::Mode::Input> {
+private:
+    friend DataStream::StreamOperators<DescriptorStream<mode, endiannes>, endiannes, mode == DataStream::Mode::Output, mode == DataStream::Mode::Input>;
+
+    int fd = -1;
+
+    // sequential buffer, output: [0, filled) not written yet, [0, position) of it is already queued in
+    // `references` with the referenced bytes, input: [position, filled) not consumed yet
+    std::vector<std::uint8_t> buffer;
+    std::size_t position = 0;
+    std::size_t filled = 0;
+    std::vector<struct iovec> references;
+
+    static constexpr std::size_t reference_threshold = 256; // smaller append_ref()s are copied
+
+    // write combining buffer, pending bytes of the file range [pending_offset, pending_offset + pending.size())
+    std::vector<std::uint8_t> pending;
+    std::size_t pending_offset = 0;
+    std::size_t combine_capacity = 0;
+
+    inline void write(const std::uint8_t* data, std::size_t size) {
+        if (this->filled + size > this->buffer.size()) {
+            this->flush();
+            if (size >= this->buffer.size()) {
+                DataStream::write_all(this->fd, data, size);
+                return;
+            }
+        }
+        std::copy_n(data, size, this->buffer.data() + this->filled);
+        this->filled += size;
+    }
+
+    inline void read(std::uint8_t* data, std::size_t size) {
+        const std::size_t buffered = std::min(size, this->filled - this->position);
+        std::copy_n(this->buffer.data() + this->position, buffered, data);
+        this->position += buffered;
+        data += buffered;
+        size -= buffered;
+        if (!size)
+            return;
+
+        this->position = this->filled = 0;
+        while (size >= this->buffer.size()) {
+            const std::size_t read = DataStream::read_some(this->fd, data, size);
+            if (!read)
+                throw std::ios_base::failure("file read failed, unexpected end of file");
+            data += read;
+            size -= read;
+        }
+        while (this->filled < size) {
+            const std::size_t read = DataStream::read_some(this->fd, this->buffer.data() + this->filled, this->buffer.size() - this->filled);
+            if (!read)
+                throw std::ios_base::failure("file read failed, unexpected end of file");
+            this->filled += read;
+        }
+        std::copy_n(this->buffer.data(), size, data);
+        this->position = size;
+    }
+
+    // buffers a positional write, flushing first if it is not adjacent to or inside the pending range
+    inline void combine_write(const std::uint8_t* data, std::size_t size, std::size_t offset) {
+        const bool inside = !this->pending.empty() && offset >= this->pending_offset && offset <= this->pending_offset + this->pending.size();
+        if (!inside || offset + size - this->pending_offset > this->combine_capacity) {
+            this->flush();
+            if (size > this->combine_capacity) {
+                DataStream::pwrite_all(this->fd, data, size, offset);
+                return;
+            }
+            this->pending_offset = offset;
+        }
+        const std::size_t start = offset - this->pending_offset;
+        if (start + size > this->pending.size())
+            this->pending.resize(start + size);
+        std::copy_n(data, size, this->pending.data() + start);
+    }
+
+
+public:
+    explicit DescriptorStream(int fd, std::size_t buffer_size = 64 * 1024)
+        : fd(fd),
+        buffer(buffer_size)
+    {
+        if (this->fd < 0)
+            throw std::invalid_argument("invalid file descriptor");
+        if (buffer_size == 0)
+            throw std::invalid_argument("buffer size must be positive");
+    }
+
+    // buffered and combined writes are flushed, errors are lost here so call flush() to observe them
+    ~DescriptorStream() {
+        try {
+            this->flush();
+        } catch (...) {}
+    }
+
+    DescriptorStream(const DescriptorStream& o) = delete;
+    DescriptorStream& operator=(const DescriptorStream& o) = delete;
+
+    DescriptorStream(DescriptorStream&& o) noexcept
+        : fd(std::exchange(o.fd, -1)),
+        buffer(std::move(o.buffer)),
+        position(std::exchange(o.position, 0)),
+        filled(std::exchange(o.filled, 0)),
+        references(std::exchange(o.references, {})),
+        pending(std::move(o.pending)),
+        pending_offset(std::exchange(o.pending_offset, 0)),
+        combine_capacity(std::exchange(o.combine_capacity, 0))
+    {
+        o.pending.clear();
+    }
+
+    DescriptorStream& operator=(DescriptorStream&& o) noexcept {
+        if (this == &o) return *this;
+        try {
+            this->flush();
+        } catch (...) {}
+        fd = std::exchange(o.fd, -1);
+        buffer = std::move(o.buffer);
+        position = std::exchange(o.position, 0);
+        filled = std::exchange(o.filled, 0);
+        references = std::exchange(o.references, {});
+        pending = std::move(o.pending);
+        o.pending.clear();
+        pending_offset = std::exchange(o.pending_offset, 0);
+        combine_capacity = std::exchange(o.combine_capacity, 0);
+        return *this;
+    }
+
+    inline int descriptor() const { return this->fd; }
+
+    // queues `bytes` to be written after everything before it without copying it, the bytes must stay
+    // valid and unchanged until the next flush(), which writes the buffer and the references with writev()
+    inline DescriptorStream& append_ref(std::span<const std::uint8_t> bytes)
+    requires (mode == DataStream::Mode::Output)
+    {
+        if (bytes.size() < reference_threshold) {
+            this->write(bytes.data(), bytes.size());
+            return *this;
+        }
+        if (this->filled > this->position)
+            this->references.push_back({ this->buffer.data() + this->position, this->filled - this->position });
+        this->position = this->filled;
+        this->references.push_back({ const_cast<std::uint8_t*>(bytes.data()), bytes.size() });
+        return *this;
+    }
+
+    // fills each destination in order with the next bytes of the stream, the bytes not buffered yet are
+    // read with readv() directly into the destinations, with the stream's buffer as the last target
+    // so small reads also refill it
+    inline DescriptorStream& read_into(std::span<const std::span<std::uint8_t>> destinations)
+    requires (mode == DataStream::Mode::Input)
+    {
+        std::vector<struct iovec> targets;
+        std::size_t wanted = 0;
+        for (std::span<std::uint8_t> destination : destinations) {
+            const std::size_t buffered = std::min(destination.size(), this->filled - this->position);
+            std::copy_n(this->buffer.data() + this->position, buffered, destination.data());
+            this->position += buffered;
+            if (buffered < destination.size()) {
+                targets.push_back({ destination.data() + buffered, destination.size() - buffered });
+                wanted += destination.size() - buffered;
+            }
+        }
+        if (!wanted)
+            return *this;
+
+        this->position = this->filled = 0;
+        targets.push_back({ this->buffer.data(), this->buffer.size() });
+        struct iovec* remaining = targets.data();
+        std::size_t count = targets.size();
+        while (wanted) {
+            const ssize_t read = ::readv(this->fd, remaining, static_cast<int>(std::min(count, DataStream::iov_max)));
+            if (read < 0) {
+                if (errno == EINTR)
+                    continue;
+                throw DataStream::io_error("file read failed");
+            }
+            if (read == 0)
+                throw std::ios_base::failure("file read failed, unexpected end of file");
+            if (static_cast<std::size_t>(read) > wanted) {
+                this->filled = read - wanted;
+                break;
+            }
+            wanted -= read;
+            DataStream::advance(remaining, count, static_cast<std::size_t>(read));
+        }
+        return *this;
+    }
+
+    inline DescriptorStream& read_into(std::initializer_list<std::span<std::uint8_t>> destinations)
+    requires (mode == DataStream::Mode::Input)
+    {
+        return this->read_into(std::span<const std::span<std::uint8_t>>(destinations.begin(), destinations.size()));
+    }
+
+    // seeks over the bytes when the descriptor supports it, reads and drops them otherwise (pipes, sockets)
+    inline void skip(std::size_t count)
+    requires (mode == DataStream::Mode::Input)
+    {
+        const std::size_t buffered = std::min(count, this->filled - this->position);
+        this->position += buffered;
+        count -= buffered;
+        if (!count)
+            return;
+        if (::lseek(this->fd, static_cast<off_t>(count), SEEK_CUR) != -1)
+            return;
+        if (errno != ESPIPE)
+            throw DataStream::io_error("file seek failed");
+        while (count) {
+            const std::size_t read = DataStream::read_some(this->fd, this->buffer.data(), std::min(count, this->buffer.size()));
+            if (!read)
+                throw std::ios_base::failure("file read failed, unexpected end of file");
+            count -= read;
+        }
+    }
+
+    // coalesce adjacent and overlapping set()s into writes of up to `capacity` bytes (0 disables)
+    inline void combine(std::size_t capacity)
+    requires ((mode & DataStream::Mode::Output) == DataStream::Mode::Output)
+    {
+        this->flush();
+        this->combine_capacity = capacity;
+        this->pending.reserve(capacity);
+    }
+
+    // bytes still in the sequential buffer are flushed first, so the patch is not overwritten by them
+    template <typename T>
+    requires std::is_arithmetic_v<T>
+    inline void set(const T& value, std::size_t start_index)
+    requires ((mode & DataStream::Mode::Output) == DataStream::Mode::Output)
+    {
+        if constexpr (mode == DataStream::Mode::Output)
+            if (this->filled || !this->references.empty())
+                this->flush();
+        const T output = this->byteswap(value);
+        const std::uint8_t* bytes = reinterpret_cast<const std::uint8_t*>(&output);
+        if (this->combine_capacity)
+            this->combine_write(bytes, sizeof(T), start_index);
+        else
+            DataStream::pwrite_all(this->fd, bytes, sizeof(T), start_index);
+    }
+
+    // sees set()s still pending in the write combining buffer
+    template <typename T>
+    requires std::is_arithmetic_v<T>
+    inline void get(T& value, std::size_t start_index) const
+    requires ((mode & DataStream::Mode::Input) == DataStream::Mode::Input)
+    {
+        std::uint8_t* bytes = reinterpret_cast<std::uint8_t*>(&value);
+        const std::size_t end = this->pending_offset + this->pending.size();
+        if (this->pending.empty() || start_index >= end || start_index + sizeof(T) <= this->pending_offset) {
+            DataStream::pread_all(this->fd, bytes, sizeof(T), start_index);
+        } else if (start_index >= this->pending_offset && start_index + sizeof(T) <= end) {
+            std::copy_n(this->pending.data() + (start_index - this->pending_offset), sizeof(T), bytes);
+        } else {
+            DataStream::pread_all(this->fd, bytes, sizeof(T), start_index);
+            for (std::size_t i = 0; i < sizeof(T); ++i)
+                if (start_index + i >= this->pending_offset && start_index + i < end)
+                    bytes[i] = this->pending[start_index + i - this->pending_offset];
+        }
+        value = this->byteswap(value);
+    }
+
+    // writes out the write combining buffer, then the sequential buffer, which only holds bytes written
+    // after every pending set() (see set())
+    inline void flush() {
+        if (!this->pending.empty()) {
+            DataStream::pwrite_all(this->fd, this->pending.data(), this->pending.size(), this->pending_offset);
+            this->pending.clear();
+        }
+        if constexpr (mode == DataStream::Mode::Output) {
+            if (!this->references.empty()) {
+                if (this->filled > this->position)
+                    this->references.push_back({ this->buffer.data() + this->position, this->filled - this->position });
+                this->position = this->filled;
+                struct iovec* remaining = this->references.data();
+                std::size_t count = this->references.size();
+                try {
+                    DataStream::writev_all(this->fd, remaining, count);
+                } catch (...) {
+                    // only the unwritten remainder stays queued, so a retry does not resend anything
+                    this->references.erase(this->references.begin(), this->references.end() - count);
+                    throw;
+                }
+                this->references.clear();
+                this->position = this->filled = 0;
+            } else if (this->filled) {
+                std::size_t written = 0;
+                try {
+                    while (written < this->filled)
+                        written += DataStream::write_some(this->fd, this->buffer.data() + written, this->filled - written);
+                } catch (...) {
+                    std::copy(this->buffer.data() + written, this->buffer.data() + this->filled, this->buffer.data());
+                    this->filled -= written;
+                    throw;
+                }
+                this->filled = 0;
+            }
+        }
+    }
+};
+
+}
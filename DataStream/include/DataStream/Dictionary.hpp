@@ -0,0 +1,150 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "DataStream/DataStream.hpp"
+#include "DataStream/Encoding.hpp"
+
+
+
+
+namespace DataStream {
+
+template <typename T>
+concept DictionaryValue =
+    std::is_integral_v<T> || std::is_same_v<T, float> || std::is_same_v<T, double> || std::is_same_v<T, std::string>;
+
+
+// each value is written as a varint code, a code equal to the current dictionary size
+// introduces a new entry and is followed by the value itself (varint length + bytes for strings),
+// the dictionary restarts empty every `block_size` values (0 keeps one dictionary for the whole stream)
+template <typename S, DictionaryValue T = std::string>
+class DictionaryWriter {
+private:
+    struct Hash {
+        using is_transparent = void;
+        inline std::size_t operator()(std::string_view value) const { return std::hash<std::string_view>{}(value); }
+        template <typename U>
+        requires std::is_arithmetic_v<U>
+        inline std::size_t operator()(U value) const { return std::hash<U>{}(value); }
+    };
+
+    using Key = std::conditional_t<std::is_same_v<T, std::string>, std::string_view, T>;
+
+    // floating point values are keyed by their bits so -0.0 and NaNs round trip exactly
+    using Stored =
+        std::conditional_t<std::is_same_v<T, float>, std::uint32_t,
+        std::conditional_t<std::is_same_v<T, double>, std::uint64_t,
+        T
+    >>;
+
+    S& stream;
+    std::size_t block_size;
+    std::size_t count = 0;
+    std::unordered_map<Stored, std::uint32_t, Hash, std::equal_to<>> codes;
+
+    static inline auto key(Key value) {
+        if constexpr (std::is_floating_point_v<T>)
+            return std::bit_cast<Stored>(value);
+        else
+            return value;
+    }
+
+public:
+    explicit DictionaryWriter(S& stream, std::size_t block_size = 0)
+        : stream(stream),
+        block_size(block_size)
+    {}
+    DictionaryWriter(const DictionaryWriter&) = delete;
+    DictionaryWriter& operator=(const DictionaryWriter&) = delete;
+    ~DictionaryWriter() = default;
+
+    inline DictionaryWriter& operator<<(Key value) {
+        if (this->block_size && this->count == this->block_size) {
+            this->codes.clear();
+            this->count = 0;
+        }
+        ++this->count;
+
+        auto it = this->codes.find(key(value));
+        if (it != this->codes.end()) {
+            DataStream::write_varint(this->stream, it->second);
+            return *this;
+        }
+
+        const std::uint32_t code = static_cast<std::uint32_t>(this->codes.size());
+        this->codes.emplace(Stored(key(value)), code);
+        DataStream::write_varint(this->stream, code);
+        if constexpr (std::is_same_v<T, std::string>) {
+            DataStream::write_varint(this->stream, value.size());
+            this->stream << std::span<const std::uint8_t>(reinterpret_cast<const std::uint8_t*>(value.data()), value.size());
+        } else {
+            this->stream << value;
+        }
+        return *this;
+    }
+
+    // number of entries in the current dictionary
+    inline std::size_t size() const { return this->codes.size(); }
+};
+
+
+template <typename S, DictionaryValue T = std::string>
+class DictionaryReader {
+private:
+    S& stream;
+    std::size_t block_size;
+    std::size_t count = 0;
+    std::vector<T> entries;
+
+public:
+    explicit DictionaryReader(S& stream, std::size_t block_size = 0)
+        : stream(stream),
+        block_size(block_size)
+    {}
+    DictionaryReader(const DictionaryReader&) = delete;
+    DictionaryReader& operator=(const DictionaryReader&) = delete;
+    ~DictionaryReader() = default;
+
+    // the returned reference stays valid until the next call
+    inline const T& next() {
+        if (this->block_size && this->count == this->block_size) {
+            this->entries.clear();
+            this->count = 0;
+        }
+        ++this->count;
+
+        const std::uint64_t code = DataStream::read_varint(this->stream);
+        if (code < this->entries.size())
+            return this->entries[code];
+        if (code > this->entries.size())
+            throw std::out_of_range("dictionary code out of range");
+
+        T& value = this->entries.emplace_back();
+        if constexpr (std::is_same_v<T, std::string>) {
+            value.resize(DataStream::read_varint(this->stream));
+            this->stream >> std::span<std::uint8_t>(reinterpret_cast<std::uint8_t*>(value.data()), value.size());
+        } else {
+            this->stream >> value;
+        }
+        return value;
+    }
+
+    inline DictionaryReader& operator>>(T& value) {
+        value = this->next();
+        return *this;
+    }
+
+    inline std::size_t size() const { return this->entries.size(); }
+};
+
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "DataStream/DataStream.hpp"
+#include "DataStream/Descriptor.hpp"
+
+
+
+
+namespace DataStream {
+
+// sequential writer that bypasses the page cache with O_DIRECT, the file is created (or truncated) and owned
+//
+// data is staged in an aligned buffer of a multiple of 4 KiB and written in whole blocks, close() pads
+// the unaligned tail to a block and truncates the file back to its real size, filesystems that reject
+// O_DIRECT get a regular buffered file (see direct())
+template <std::endian endiannes = std::endian::native>
+class DirectFileStream : public DataStream::StreamOperators<DirectFileStream<endiannes>, endiannes, true, false> {
+private:
+    friend DataStream::StreamOperators<DirectFileStream<endiannes>, endiannes, true, false>;
+
+    static constexpr std::size_t alignment = 4096;
+
+    int fd = -1;
+    bool bypass = false;
+    DataStream::AlignedBuffer buffer;
+    std::size_t capacity = 0;
+    std::size_t filled = 0;
+    std::size_t offset = 0; // file offset of buffer[0], always aligned
+
+    inline void write(const std::uint8_t* data, std::size_t size) {
+        if (this->fd < 0)
+            throw std::logic_error("write to closed direct file stream");
+        while (size) {
+            const std::size_t count = std::min(size, this->capacity - this->filled);
+            std::copy_n(data, count, this->buffer.get() + this->filled);
+            this->filled += count;
+            data += count;
+            size -= count;
+            if (this->filled == this->capacity) {
+                DataStream::pwrite_all(this->fd, this->buffer.get(), this->capacity, this->offset);
+                this->offset += this->capacity;
+                this->filled = 0;
+            }
+        }
+    }
+
+
+public:
+    // buffer_size is rounded up to a multiple of 4 KiB, a non zero `preallocate` reserves that many bytes
+    // with fallocate() up front so the file is laid out contiguously (ignored where unsupported)
+    explicit DirectFileStream(const std::string& path, std::size_t buffer_size = 1024 * 1024, std::size_t preallocate = 0)
+        : buffer(DataStream::aligned_buffer(alignment, std::max<std::size_t>(buffer_size, 1))),
+        capacity((std::max<std::size_t>(buffer_size, 1) + alignment - 1) / alignment * alignment)
+    {
+        const int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+        do {
+            this->fd = ::open(path.c_str(), flags | O_DIRECT, 0644);
+        } while (this->fd < 0 && errno == EINTR);
+        this->bypass = this->fd >= 0;
+        if (this->fd < 0 && errno == EINVAL) {
+            do {
+                this->fd = ::open(path.c_str(), flags, 0644);
+            } while (this->fd < 0 && errno == EINTR);
+        }
+        if (this->fd < 0)
+            throw DataStream::io_error("file open failed");
+
+        if (preallocate && ::fallocate(this->fd, 0, 0, static_cast<off_t>(preallocate)) != 0 && errno != EOPNOTSUPP && errno != ENOSYS) {
+            const int error = errno;
+            ::close(this->fd);
+            throw DataStream::io_error("file preallocation failed", error);
+        }
+    }
+
+    // closes the file, errors are lost here so call close() to observe them
+    ~DirectFileStream() {
+        try {
+            this->close();
+        } catch (...) {}
+    }
+
+    DirectFileStream(const DirectFileStream& o) = delete;
+    DirectFileStream& operator=(const DirectFileStream& o) = delete;
+    DirectFileStream(DirectFileStream&& o) = delete;
+    DirectFileStream& operator=(DirectFileStream&& o) = delete;
+
+    // whether writes actually bypass the page cache
+    inline bool direct() const { return this->bypass; }
+
+    // bytes written so far
+    inline std::size_t size() const { return this->offset + this->filled; }
+
+    // writes the tail padded to a whole block, truncates the padding (and any unused preallocation) away
+    inline void close() {
+        if (this->fd < 0)
+            return;
+        const int fd = std::exchange(this->fd, -1);
+        try {
+            const std::size_t size = this->offset + this->filled;
+            if (this->filled) {
+                const std::size_t padded = (this->filled + alignment - 1) / alignment * alignment;
+                std::fill(this->buffer.get() + this->filled, this->buffer.get() + padded, std::uint8_t(0));
+                DataStream::pwrite_all(fd, this->buffer.get(), padded, this->offset);
+            }
+            if (::ftruncate(fd, static_cast<off_t>(size)) != 0)
+                throw DataStream::io_error("file truncate failed");
+        } catch (...) {
+            ::close(fd);
+            throw;
+        }
+        if (::close(fd) != 0)
+            throw DataStream::io_error("file close failed");
+    }
+};
+
+}
@@ -0,0 +1,243 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "DataStream/DataStream.hpp"
+#include "DataStream/Encoding.hpp"
+
+
+
+
+namespace DataStream {
+
+struct EliasFanoLayout {
+    static constexpr std::size_t sample_rate = 256; // ones/zeros between select samples
+    static constexpr std::size_t header_size = 2 * sizeof(std::uint64_t) + 1;
+
+    std::uint64_t count = 0;
+    std::uint64_t last = 0;
+    unsigned low_width = 0;
+
+    inline std::uint64_t buckets() const { return this->count ? (this->last >> this->low_width) + 1 : 0; }
+    inline std::size_t one_samples() const { return this->count ? (this->count - 1) / sample_rate + 1 : 0; }
+    inline std::size_t zero_samples() const { return this->count ? (this->buckets() - 1) / sample_rate + 1 : 0; }
+    inline std::size_t low_words() const { return (this->count * this->low_width + 63) / 64; }
+    inline std::size_t high_words() const { return this->count ? (this->count + this->buckets() + 63) / 64 : 0; }
+
+    inline std::size_t size() const {
+        return header_size + (this->one_samples() + this->zero_samples() + this->low_words() + this->high_words()) * sizeof(std::uint64_t);
+    }
+
+    static inline std::uint64_t word(const std::uint8_t* words, std::size_t w) {
+        return DataStream::load<std::uint64_t, std::endian::little>(words + w * sizeof(std::uint64_t));
+    }
+
+    // low bits of the i-th value
+    inline std::uint64_t low_bits(const std::uint8_t* low, std::size_t i) const {
+        if (!this->low_width)
+            return 0;
+        const std::size_t position = i * this->low_width;
+        std::uint64_t bits = word(low, position / 64) >> (position % 64);
+        if (position % 64 + this->low_width > 64)
+            bits |= word(low, position / 64 + 1) << (64 - position % 64);
+        return bits & ((std::uint64_t(1) << this->low_width) - 1);
+    }
+
+    // first set bit of the high bits at or after `position`
+    inline std::size_t next_one(const std::uint8_t* high, std::size_t position) const {
+        std::size_t w = position / 64;
+        if (w >= this->high_words())
+            throw std::out_of_range("elias fano high bits out of range");
+        std::uint64_t bits = word(high, w) & (~std::uint64_t(0) << (position % 64));
+        while (!bits) {
+            if (++w == this->high_words())
+                throw std::out_of_range("elias fano high bits out of range");
+            bits = word(high, w);
+        }
+        return w * 64 + std::countr_zero(bits);
+    }
+
+    static inline EliasFanoLayout of(std::uint64_t count, std::uint64_t last) {
+        EliasFanoLayout layout;
+        layout.count = count;
+        layout.last = last;
+        layout.low_width = count && last / count > 1 ? std::bit_width(last / count) - 1 : 0;
+        return layout;
+    }
+};
+
+
+// writes sorted values as:
+//   uint64 count, uint64 last value, uint8 low bit width,
+//   uint64 positions of every 256th one and every 256th zero of the high bits,
+//   low bits and high bits (unary coded buckets) as little endian 64 bit words
+template <typename S>
+inline void write_elias_fano(S& stream, std::span<const std::uint64_t> values) {
+    for (std::size_t i = 1; i < values.size(); ++i)
+        if (values[i] < values[i - 1])
+            throw std::invalid_argument("values are not sorted");
+
+    const EliasFanoLayout layout = EliasFanoLayout::of(values.size(), values.empty() ? 0 : values.back());
+    const unsigned width = layout.low_width;
+    std::vector<std::uint64_t> low(layout.low_words(), 0);
+    std::vector<std::uint64_t> high(layout.high_words(), 0);
+    std::vector<std::uint64_t> ones, zeros;
+    ones.reserve(layout.one_samples());
+    zeros.reserve(layout.zero_samples());
+
+    std::uint64_t bucket = 0;
+    for (std::size_t i = 0; i < values.size(); ++i) {
+        if (width) {
+            const std::uint64_t bits = values[i] & ((std::uint64_t(1) << width) - 1);
+            const std::size_t position = i * width;
+            low[position / 64] |= bits << (position % 64);
+            if (position % 64 + width > 64)
+                low[position / 64 + 1] |= bits >> (64 - position % 64);
+        }
+        // the zero closing each bucket before this value's bucket precedes its one
+        for (; bucket < (values[i] >> width); ++bucket)
+            if (bucket % EliasFanoLayout::sample_rate == 0)
+                zeros.push_back(bucket + i);
+        const std::size_t position = i + (values[i] >> width);
+        high[position / 64] |= std::uint64_t(1) << (position % 64);
+        if (i % EliasFanoLayout::sample_rate == 0)
+            ones.push_back(position);
+    }
+    for (; bucket < layout.buckets(); ++bucket)
+        if (bucket % EliasFanoLayout::sample_rate == 0)
+            zeros.push_back(bucket + values.size());
+
+    if constexpr (std::endian::native != std::endian::little) {
+        for (std::uint64_t& word : low)
+            word = DataStream::byteswap(word);
+        for (std::uint64_t& word : high)
+            word = DataStream::byteswap(word);
+    }
+
+    stream << layout.count << layout.last << static_cast<std::uint8_t>(width);
+    stream << std::span<const std::uint64_t>(ones) << std::span<const std::uint64_t>(zeros);
+    stream << std::span<const std::uint8_t>(reinterpret_cast<const std::uint8_t*>(low.data()), low.size() * sizeof(std::uint64_t));
+    stream << std::span<const std::uint8_t>(reinterpret_cast<const std::uint8_t*>(high.data()), high.size() * sizeof(std::uint64_t));
+}
+
+
+// zero copy view over values written by write_elias_fano() with the given stream endianness
+template <std::endian endiannes = std::endian::native>
+class EliasFano {
+private:
+    EliasFanoLayout layout;
+    const std::uint8_t* ones = nullptr;
+    const std::uint8_t* zeros = nullptr;
+    const std::uint8_t* low = nullptr;
+    const std::uint8_t* high = nullptr;
+
+    // position of the `rank`-th set bit of `word`
+    static inline unsigned select_in_word(std::uint64_t word, unsigned rank) {
+        for (; rank; --rank)
+            word &= word - 1;
+        return std::countr_zero(word);
+    }
+
+    // position of the k-th one (or zero) of the high bits, starting from the closest sample
+    template <bool one>
+    inline std::size_t select_high(std::size_t k) const {
+        const std::uint8_t* samples = one ? this->ones : this->zeros;
+        std::size_t position = DataStream::load<std::uint64_t, endiannes>(samples + (k / EliasFanoLayout::sample_rate) * 8);
+        unsigned rank = k % EliasFanoLayout::sample_rate;
+
+        std::size_t w = position / 64;
+        auto high_word = [&] {
+            if (w >= this->layout.high_words())
+                throw std::out_of_range("elias fano high bits out of range");
+            const std::uint64_t word = EliasFanoLayout::word(this->high, w);
+            return one ? word : ~word;
+        };
+        std::uint64_t word = high_word() & (~std::uint64_t(0) << (position % 64));
+        for (;;) {
+            const unsigned bits = std::popcount(word);
+            if (rank < bits)
+                return w * 64 + select_in_word(word, rank);
+            rank -= bits;
+            ++w;
+            word = high_word();
+        }
+    }
+
+public:
+    explicit EliasFano(std::span<const std::uint8_t> bytes) {
+        if (bytes.size() < EliasFanoLayout::header_size)
+            throw std::out_of_range("elias fano data truncated");
+        this->layout.count = DataStream::load<std::uint64_t, endiannes>(bytes.data());
+        this->layout.last = DataStream::load<std::uint64_t, endiannes>(bytes.data() + 8);
+        this->layout.low_width = bytes[16];
+        if (this->layout.low_width != EliasFanoLayout::of(this->layout.count, this->layout.last).low_width)
+            throw std::runtime_error("invalid elias fano header");
+        if (this->layout.count / 8 > bytes.size() || bytes.size() < this->layout.size())
+            throw std::out_of_range("elias fano data truncated");
+
+        this->ones = bytes.data() + EliasFanoLayout::header_size;
+        this->zeros = this->ones + this->layout.one_samples() * 8;
+        this->low = this->zeros + this->layout.zero_samples() * 8;
+        this->high = this->low + this->layout.low_words() * 8;
+    }
+
+    inline std::size_t size() const { return this->layout.count; }
+    inline std::size_t size_bytes() const { return this->layout.size(); }
+
+    // i-th smallest value
+    inline std::uint64_t select(std::size_t i) const {
+        if (i >= this->layout.count)
+            throw std::out_of_range("index out of range");
+        return ((this->select_high<true>(i) - i) << this->layout.low_width) | this->layout.low_bits(this->low, i);
+    }
+
+    // index and value of the first value not less than `x`, { size(), 0 } if there is none
+    inline std::pair<std::size_t, std::uint64_t> next_geq(std::uint64_t x) const {
+        if (!this->layout.count || x > this->layout.last)
+            return { this->layout.count, 0 };
+
+        const std::uint64_t bucket = x >> this->layout.low_width;
+        std::size_t position = bucket ? this->select_high<false>(bucket - 1) + 1 : 0;
+        for (std::size_t i = position - bucket; i < this->layout.count; ++i, ++position) {
+            position = this->layout.next_one(this->high, position);
+            const std::uint64_t value = ((position - i) << this->layout.low_width) | this->layout.low_bits(this->low, i);
+            if (value >= x)
+                return { i, value };
+        }
+        return { this->layout.count, 0 };
+    }
+
+    // number of values less than `x`
+    inline std::size_t rank(std::uint64_t x) const { return this->next_geq(x).first; }
+};
+
+
+// sequentially decodes values written by write_elias_fano() from any stream
+template <typename S>
+inline void read_elias_fano(S& stream, std::vector<std::uint64_t>& values) {
+    EliasFanoLayout layout;
+    std::uint8_t width;
+    stream >> layout.count >> layout.last >> width;
+    layout.low_width = width;
+    if (width != EliasFanoLayout::of(layout.count, layout.last).low_width)
+        throw std::runtime_error("invalid elias fano header");
+
+    stream.skip((layout.one_samples() + layout.zero_samples()) * sizeof(std::uint64_t));
+    std::vector<std::uint8_t> low(layout.low_words() * sizeof(std::uint64_t));
+    std::vector<std::uint8_t> high(layout.high_words() * sizeof(std::uint64_t));
+    stream >> std::span<std::uint8_t>(low) >> std::span<std::uint8_t>(high);
+
+    values.resize(layout.count);
+    std::size_t position = 0;
+    for (std::size_t i = 0; i < values.size(); ++i, ++position) {
+        position = layout.next_one(high.data(), position);
+        values[i] = ((position - i) << width) | layout.low_bits(low.data(), i);
+    }
+}
+
+}
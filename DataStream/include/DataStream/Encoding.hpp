@@ -0,0 +1,187 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+
+#include "DataStream/DataStream.hpp"
+
+
+
+
+namespace DataStream {
+
+inline constexpr std::uint64_t zigzag(std::int64_t value) {
+    return (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63);
+}
+
+inline constexpr std::int64_t unzigzag(std::uint64_t value) {
+    return static_cast<std::int64_t>((value >> 1) ^ (~(value & 1) + 1));
+}
+
+inline constexpr std::size_t varint_size(std::uint64_t value) {
+    return value ? (std::bit_width(value) + 6) / 7 : 1;
+}
+
+inline constexpr std::size_t bit_packed_size(std::size_t count, unsigned width) {
+    return (count * width + 7) / 8;
+}
+
+
+// unchecked load of a value stored with the given endianness, for zero copy views over encoded bytes
+template <typename T, std::endian endiannes = std::endian::native>
+requires std::is_arithmetic_v<T>
+inline T load(const std::uint8_t* data) {
+    T value;
+    std::copy_n(data, sizeof(T), reinterpret_cast<std::uint8_t*>(&value));
+    return endiannes != std::endian::native ? DataStream::byteswap(value) : value;
+}
+
+// decodes the varint at `position` from memory and advances `position` past it
+inline std::uint64_t decode_varint(std::span<const std::uint8_t> bytes, std::size_t& position) {
+    std::uint64_t value = 0;
+    for (unsigned shift = 0; shift < 64 && position < bytes.size(); shift += 7) {
+        const std::uint8_t byte = bytes[position++];
+        value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            return value;
+    }
+    throw std::out_of_range("varint out of range");
+}
+
+
+// LEB128, 7 bits per byte, least significant group first
+template <typename S>
+inline void write_varint(S& stream, std::uint64_t value) {
+    std::array<std::uint8_t, 10> bytes;
+    std::size_t size = 0;
+    while (value >= 0x80) {
+        bytes[size++] = static_cast<std::uint8_t>(value) | 0x80;
+        value >>= 7;
+    }
+    bytes[size++] = static_cast<std::uint8_t>(value);
+    stream << std::span<const std::uint8_t>(bytes.data(), size);
+}
+
+template <typename S>
+inline std::uint64_t read_varint(S& stream) {
+    std::uint64_t value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+        std::uint8_t byte;
+        stream >> byte;
+        value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            return value;
+    }
+    throw std::runtime_error("varint too long");
+}
+
+
+// packs values of `width` bits, least significant bit first, into whole bytes
+template <typename S>
+class BitWriter {
+private:
+    S& stream;
+    std::uint64_t buffer = 0;
+    unsigned count = 0;
+    std::array<std::uint8_t, 256> bytes;
+    std::size_t size = 0;
+
+    inline void put(std::uint64_t value, unsigned width) {
+        this->buffer |= (width < 64 ? value & ((std::uint64_t(1) << width) - 1) : value) << this->count;
+        this->count += width;
+        while (this->count >= 8) {
+            this->bytes[this->size++] = static_cast<std::uint8_t>(this->buffer);
+            this->buffer >>= 8;
+            this->count -= 8;
+            if (this->size == this->bytes.size()) {
+                this->stream << std::span<const std::uint8_t>(this->bytes.data(), this->size);
+                this->size = 0;
+            }
+        }
+    }
+
+public:
+    explicit BitWriter(S& stream) : stream(stream) {}
+    BitWriter(const BitWriter&) = delete;
+    BitWriter& operator=(const BitWriter&) = delete;
+    ~BitWriter() = default;
+
+    inline void write(std::uint64_t value, unsigned width) {
+        if (width > 32) {
+            this->put(value, 32);
+            this->put(value >> 32, width - 32);
+        } else if (width) {
+            this->put(value, width);
+        }
+    }
+
+    // pads the last byte with zero bits and writes out everything staged
+    inline void flush() {
+        if (this->count)
+            this->put(0, 8 - this->count);
+        if (this->size)
+            this->stream << std::span<const std::uint8_t>(this->bytes.data(), this->size);
+        this->size = 0;
+    }
+};
+
+
+// reads back exactly `bytes` bytes of BitWriter output from the stream
+template <typename S>
+class BitReader {
+private:
+    S& stream;
+    std::size_t remaining;
+    std::uint64_t buffer = 0;
+    unsigned count = 0;
+    std::array<std::uint8_t, 256> bytes;
+    std::size_t position = 0;
+    std::size_t size = 0;
+
+    inline std::uint64_t take(unsigned width) {
+        while (this->count < width) {
+            if (this->position == this->size) {
+                if (!this->remaining)
+                    throw std::out_of_range("bit packed data exhausted");
+                this->size = std::min(this->remaining, this->bytes.size());
+                this->stream >> std::span<std::uint8_t>(this->bytes.data(), this->size);
+                this->remaining -= this->size;
+                this->position = 0;
+            }
+            this->buffer |= static_cast<std::uint64_t>(this->bytes[this->position++]) << this->count;
+            this->count += 8;
+        }
+        std::uint64_t value = this->buffer & ((std::uint64_t(1) << width) - 1);
+        this->buffer >>= width;
+        this->count -= width;
+        return value;
+    }
+
+public:
+    BitReader(S& stream, std::size_t bytes) : stream(stream), remaining(bytes) {}
+    BitReader(const BitReader&) = delete;
+    BitReader& operator=(const BitReader&) = delete;
+    ~BitReader() = default;
+
+    inline std::uint64_t read(unsigned width) {
+        if (width > 32) {
+            std::uint64_t low = this->take(32);
+            return low | (this->take(width - 32) << 32);
+        }
+        return width ? this->take(width) : 0;
+    }
+
+    // consumes whatever is left of the packed bytes
+    inline void finish() {
+        if (this->remaining)
+            this->stream.skip(this->remaining);
+        this->remaining = 0;
+    }
+};
+
+}
@@ -0,0 +1,209 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "DataStream/DataStream.hpp"
+#include "DataStream/Encoding.hpp"
+
+
+
+
+namespace DataStream {
+
+// writes sorted keys as a front coded block:
+//   uint32 count, uint32 restart interval, uint32 restart offsets[ceil(count / interval)], uint32 entries size,
+//   entries of { varint shared prefix length, varint suffix length, suffix bytes },
+// every `restart_interval`-th key shares nothing with its predecessor so lookups can start there
+template <typename S>
+inline void write_front_coded(S& stream, std::span<const std::string> keys, std::size_t restart_interval = 16) {
+    if (restart_interval == 0)
+        throw std::invalid_argument("restart interval must be positive");
+    if (keys.size() > UINT32_MAX)
+        throw std::length_error("too many keys");
+
+    std::vector<std::uint32_t> shared(keys.size(), 0);
+    std::vector<std::uint32_t> restarts;
+    restarts.reserve((keys.size() + restart_interval - 1) / restart_interval);
+    std::size_t size = 0;
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        if (i && keys[i] < keys[i - 1])
+            throw std::invalid_argument("keys are not sorted");
+        if (i % restart_interval == 0) {
+            restarts.push_back(static_cast<std::uint32_t>(size));
+        } else {
+            auto [a, b] = std::mismatch(keys[i].begin(), keys[i].end(), keys[i - 1].begin(), keys[i - 1].end());
+            shared[i] = static_cast<std::uint32_t>(a - keys[i].begin());
+        }
+        const std::size_t suffix = keys[i].size() - shared[i];
+        size += DataStream::varint_size(shared[i]) + DataStream::varint_size(suffix) + suffix;
+        if (size > UINT32_MAX)
+            throw std::length_error("front coded block too large");
+    }
+
+    stream << static_cast<std::uint32_t>(keys.size()) << static_cast<std::uint32_t>(restart_interval);
+    stream << std::span<const std::uint32_t>(restarts) << static_cast<std::uint32_t>(size);
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        const std::size_t suffix = keys[i].size() - shared[i];
+        DataStream::write_varint(stream, shared[i]);
+        DataStream::write_varint(stream, suffix);
+        stream << std::span<const std::uint8_t>(reinterpret_cast<const std::uint8_t*>(keys[i].data()) + shared[i], suffix);
+    }
+}
+
+// sequentially decodes a whole block written by write_front_coded()
+template <typename S>
+inline void read_front_coded(S& stream, std::vector<std::string>& keys) {
+    std::uint32_t count, interval, size;
+    stream >> count >> interval;
+    if (interval == 0)
+        throw std::runtime_error("invalid restart interval");
+    stream.skip(std::size_t((count + std::uint64_t(interval) - 1) / interval) * sizeof(std::uint32_t));
+    stream >> size;
+
+    keys.clear();
+    keys.reserve(count);
+    std::string key;
+    for (std::uint32_t i = 0; i < count; ++i) {
+        const std::uint64_t shared = DataStream::read_varint(stream);
+        const std::uint64_t suffix = DataStream::read_varint(stream);
+        if (shared > key.size())
+            throw std::runtime_error("invalid shared prefix length");
+        key.resize(shared + suffix);
+        stream >> std::span<std::uint8_t>(reinterpret_cast<std::uint8_t*>(key.data()) + shared, suffix);
+        keys.push_back(key);
+    }
+}
+
+
+// zero copy view over a block written by write_front_coded() with the given stream endianness,
+// lookups binary search the restart keys and decode at most one restart interval
+template <std::endian endiannes = std::endian::native>
+class FrontCodedBlock {
+private:
+    const std::uint8_t* restarts = nullptr;
+    std::span<const std::uint8_t> entries;
+    std::uint32_t count = 0;
+    std::uint32_t interval = 0;
+    std::uint32_t restart_count = 0;
+
+    inline std::size_t restart(std::size_t r) const {
+        const std::uint32_t offset = DataStream::load<std::uint32_t, endiannes>(this->restarts + r * sizeof(std::uint32_t));
+        if (offset >= this->entries.size())
+            throw std::out_of_range("restart offset out of range");
+        return offset;
+    }
+
+    // decodes the entry at `position` on top of `key` and advances past it
+    inline void next(std::size_t& position, std::string& key) const {
+        const std::uint64_t shared = DataStream::decode_varint(this->entries, position);
+        const std::uint64_t suffix = DataStream::decode_varint(this->entries, position);
+        if (shared > key.size() || suffix > this->entries.size() - position)
+            throw std::out_of_range("front coded entry out of range");
+        key.resize(shared);
+        key.append(reinterpret_cast<const char*>(this->entries.data()) + position, suffix);
+        position += suffix;
+    }
+
+    // the key at a restart point is stored whole and is compared in place
+    inline std::string_view restart_key(std::size_t r) const {
+        std::size_t position = this->restart(r);
+        DataStream::decode_varint(this->entries, position);
+        const std::uint64_t suffix = DataStream::decode_varint(this->entries, position);
+        if (suffix > this->entries.size() - position)
+            throw std::out_of_range("front coded entry out of range");
+        return std::string_view(reinterpret_cast<const char*>(this->entries.data()) + position, suffix);
+    }
+
+    inline std::size_t locate(std::string_view key, bool& equal) const {
+        equal = false;
+        std::size_t low = 0, high = this->restart_count;
+        while (low < high) {
+            const std::size_t middle = low + (high - low) / 2;
+            if (this->restart_key(middle) < key)
+                low = middle + 1;
+            else
+                high = middle;
+        }
+        if (low == 0) {
+            equal = this->count && this->restart_key(0) == key;
+            return 0;
+        }
+
+        const std::size_t first = (low - 1) * this->interval;
+        const std::size_t last = std::min<std::size_t>(first + this->interval, this->count);
+        std::string current;
+        std::size_t position = this->restart(low - 1);
+        for (std::size_t i = first; i < last; ++i) {
+            this->next(position, current);
+            if (current >= key) {
+                equal = current == key;
+                return i;
+            }
+        }
+        equal = last < this->count && this->restart_key(low) == key;
+        return last;
+    }
+
+public:
+    explicit FrontCodedBlock(std::span<const std::uint8_t> bytes) {
+        if (bytes.size() < 2 * sizeof(std::uint32_t))
+            throw std::out_of_range("front coded block truncated");
+        this->count = DataStream::load<std::uint32_t, endiannes>(bytes.data());
+        this->interval = DataStream::load<std::uint32_t, endiannes>(bytes.data() + sizeof(std::uint32_t));
+        if (this->interval == 0)
+            throw std::runtime_error("invalid restart interval");
+        this->restart_count = static_cast<std::uint32_t>((this->count + std::uint64_t(this->interval) - 1) / this->interval);
+
+        const std::size_t header = (3 + std::size_t(this->restart_count)) * sizeof(std::uint32_t);
+        if (bytes.size() < header)
+            throw std::out_of_range("front coded block truncated");
+        this->restarts = bytes.data() + 2 * sizeof(std::uint32_t);
+        const std::uint32_t size = DataStream::load<std::uint32_t, endiannes>(bytes.data() + header - sizeof(std::uint32_t));
+        if (bytes.size() - header < size)
+            throw std::out_of_range("front coded block truncated");
+        this->entries = bytes.subspan(header, size);
+    }
+
+    inline std::size_t size() const { return this->count; }
+
+    // number of bytes the block occupies
+    inline std::size_t size_bytes() const {
+        return (3 + std::size_t(this->restart_count)) * sizeof(std::uint32_t) + this->entries.size();
+    }
+
+    inline std::string key(std::size_t i) const {
+        if (i >= this->count)
+            throw std::out_of_range("key index out of range");
+        std::string key;
+        std::size_t position = this->restart(i / this->interval);
+        for (std::size_t j = i - i % this->interval; j <= i; ++j)
+            this->next(position, key);
+        return key;
+    }
+
+    // index of the first key not less than `key`, size() if there is none
+    inline std::size_t lower_bound(std::string_view key) const {
+        bool equal;
+        return this->locate(key, equal);
+    }
+
+    inline std::optional<std::size_t> find(std::string_view key) const {
+        bool equal;
+        const std::size_t i = this->locate(key, equal);
+        if (equal)
+            return i;
+        return std::nullopt;
+    }
+
+    inline bool contains(std::string_view key) const { return this->find(key).has_value(); }
+};
+
+}
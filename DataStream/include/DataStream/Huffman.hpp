@@ -0,0 +1,251 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "DataStream/DataStream.hpp"
+#include "DataStream/Encoding.hpp"
+
+
+
+
+namespace DataStream {
+
+struct Huffman {
+    static constexpr unsigned max_length = 11; // longest code, also the decode table index width
+    static constexpr std::size_t lanes = 4; // independently coded segments decoded in lockstep
+
+    struct Code {
+        std::uint16_t bits = 0; // bit reversed, to be written least significant bit first
+        std::uint8_t length = 0;
+    };
+
+    struct Entry {
+        std::uint8_t symbol = 0;
+        std::uint8_t length = 0;
+    };
+
+    // code lengths of a length limited huffman code, frequencies are halved until the code fits
+    static inline std::array<std::uint8_t, 256> lengths(std::array<std::uint64_t, 256> frequencies) {
+        std::array<std::uint8_t, 256> lengths{};
+        for (;;) {
+            std::vector<std::pair<std::uint64_t, int>> heap;
+            for (int symbol = 0; symbol < 256; ++symbol)
+                if (frequencies[symbol])
+                    heap.emplace_back(frequencies[symbol], symbol);
+            if (heap.empty())
+                return lengths;
+            if (heap.size() == 1) {
+                lengths[heap.front().second] = 1;
+                return lengths;
+            }
+
+            std::array<int, 511> parent;
+            parent.fill(-1);
+            int node = 256;
+            std::make_heap(heap.begin(), heap.end(), std::greater<>());
+            while (heap.size() > 1) {
+                std::pop_heap(heap.begin(), heap.end(), std::greater<>());
+                auto a = heap.back();
+                heap.pop_back();
+                std::pop_heap(heap.begin(), heap.end(), std::greater<>());
+                auto b = heap.back();
+                heap.pop_back();
+                parent[a.second] = parent[b.second] = node;
+                heap.emplace_back(a.first + b.first, node++);
+                std::push_heap(heap.begin(), heap.end(), std::greater<>());
+            }
+
+            unsigned longest = 0;
+            for (int symbol = 0; symbol < 256; ++symbol) {
+                unsigned depth = 0;
+                if (frequencies[symbol])
+                    for (int n = symbol; parent[n] != -1; n = parent[n])
+                        ++depth;
+                lengths[symbol] = static_cast<std::uint8_t>(depth);
+                longest = std::max(longest, depth);
+            }
+            if (longest <= max_length)
+                return lengths;
+            for (std::uint64_t& frequency : frequencies)
+                if (frequency)
+                    frequency = (frequency >> 1) | 1;
+        }
+    }
+
+    // canonical codes assigned in order of (length, symbol)
+    static inline std::array<Code, 256> codes(const std::array<std::uint8_t, 256>& lengths) {
+        std::array<std::uint16_t, 256> order;
+        for (unsigned i = 0; i < 256; ++i)
+            order[i] = static_cast<std::uint16_t>(i);
+        std::stable_sort(order.begin(), order.end(), [&](std::uint16_t a, std::uint16_t b) { return lengths[a] < lengths[b]; });
+
+        std::array<Code, 256> codes{};
+        std::uint32_t code = 0;
+        unsigned previous = 0;
+        for (std::uint16_t symbol : order) {
+            const unsigned length = lengths[symbol];
+            if (!length)
+                continue;
+            if (length > max_length)
+                throw std::runtime_error("invalid huffman code length");
+            code <<= length - previous;
+            previous = length;
+            if (code >> length)
+                throw std::runtime_error("oversubscribed huffman code");
+            std::uint16_t reversed = 0;
+            for (unsigned i = 0; i < length; ++i)
+                reversed |= ((code >> i) & 1) << (length - 1 - i);
+            codes[symbol] = { reversed, static_cast<std::uint8_t>(length) };
+            ++code;
+        }
+        return codes;
+    }
+
+    // decode table indexed by the next max_length bits of the stream
+    static inline std::vector<Entry> table(const std::array<std::uint8_t, 256>& lengths) {
+        const std::array<Code, 256> codes = Huffman::codes(lengths);
+        std::vector<Entry> table(std::size_t(1) << max_length);
+        for (unsigned symbol = 0; symbol < 256; ++symbol) {
+            const Code code = codes[symbol];
+            if (!code.length)
+                continue;
+            for (std::size_t i = code.bits; i < table.size(); i += std::size_t(1) << code.length)
+                table[i] = { static_cast<std::uint8_t>(symbol), code.length };
+        }
+        return table;
+    }
+};
+
+
+// writes a canonical huffman coded block:
+//   varint size, 256 code lengths as 4 bit nibbles, uint32 byte size of each of the 4 lanes, lane bits,
+// the input is split into 4 equal segments coded as separate bit streams so decoding can interleave them
+template <typename S>
+inline void write_huffman(S& stream, std::span<const std::uint8_t> bytes) {
+    DataStream::write_varint(stream, bytes.size());
+    if (bytes.empty())
+        return;
+
+    std::array<std::uint64_t, 256> frequencies{};
+    for (std::uint8_t byte : bytes)
+        ++frequencies[byte];
+    const std::array<std::uint8_t, 256> lengths = Huffman::lengths(frequencies);
+    const std::array<Huffman::Code, 256> codes = Huffman::codes(lengths);
+
+    std::array<std::uint8_t, 128> nibbles;
+    for (std::size_t i = 0; i < nibbles.size(); ++i)
+        nibbles[i] = static_cast<std::uint8_t>(lengths[2 * i] | (lengths[2 * i + 1] << 4));
+    stream << std::span<const std::uint8_t>(nibbles);
+
+    const std::size_t segment = (bytes.size() + Huffman::lanes - 1) / Huffman::lanes;
+    std::array<std::span<const std::uint8_t>, Huffman::lanes> lanes;
+    for (std::size_t lane = 0; lane < Huffman::lanes; ++lane) {
+        const std::size_t first = std::min(lane * segment, bytes.size());
+        lanes[lane] = bytes.subspan(first, std::min(segment, bytes.size() - first));
+        std::uint64_t bits = 0;
+        for (std::uint8_t byte : lanes[lane])
+            bits += codes[byte].length;
+        if ((bits + 7) / 8 > UINT32_MAX)
+            throw std::length_error("huffman lane too large");
+        stream << static_cast<std::uint32_t>((bits + 7) / 8);
+    }
+
+    for (std::span<const std::uint8_t> lane : lanes) {
+        DataStream::BitWriter<S> writer(stream);
+        for (std::uint8_t byte : lane)
+            writer.write(codes[byte].bits, codes[byte].length);
+        writer.flush();
+    }
+}
+
+template <typename S>
+inline void read_huffman(S& stream, std::vector<std::uint8_t>& bytes) {
+    bytes.resize(DataStream::read_varint(stream));
+    if (bytes.empty())
+        return;
+
+    std::array<std::uint8_t, 128> nibbles;
+    stream >> std::span<std::uint8_t>(nibbles);
+    std::array<std::uint8_t, 256> lengths;
+    for (std::size_t i = 0; i < nibbles.size(); ++i) {
+        lengths[2 * i] = nibbles[i] & 0x0F;
+        lengths[2 * i + 1] = nibbles[i] >> 4;
+    }
+    const std::vector<Huffman::Entry> table = Huffman::table(lengths);
+
+    std::array<std::uint32_t, Huffman::lanes> sizes;
+    stream >> std::span<std::uint32_t>(sizes);
+    std::size_t total = 0;
+    for (std::uint32_t size : sizes)
+        total += size;
+    std::vector<std::uint8_t> coded(total);
+    stream >> std::span<std::uint8_t>(coded);
+
+    struct Lane {
+        const std::uint8_t* position;
+        const std::uint8_t* end;
+        std::uint64_t buffer = 0;
+        unsigned count = 0;
+
+        // keeps at least 56 bits buffered, zero bits past the end are never consumed by valid data
+        inline void refill() {
+            while (this->count <= 56) {
+                this->buffer |= std::uint64_t(this->position < this->end ? *this->position++ : 0) << this->count;
+                this->count += 8;
+            }
+        }
+
+        inline std::uint8_t decode(const Huffman::Entry* table) {
+            const Huffman::Entry entry = table[this->buffer & ((std::uint64_t(1) << Huffman::max_length) - 1)];
+            if (!entry.length)
+                throw std::runtime_error("invalid huffman code");
+            this->buffer >>= entry.length;
+            this->count -= entry.length;
+            return entry.symbol;
+        }
+    };
+
+    const std::size_t segment = (bytes.size() + Huffman::lanes - 1) / Huffman::lanes;
+    std::array<Lane, Huffman::lanes> lanes;
+    std::array<std::uint8_t*, Huffman::lanes> outputs;
+    std::array<std::size_t, Huffman::lanes> counts;
+    const std::uint8_t* position = coded.data();
+    for (std::size_t lane = 0; lane < Huffman::lanes; ++lane) {
+        lanes[lane] = { position, position + sizes[lane] };
+        position += sizes[lane];
+        const std::size_t first = std::min(lane * segment, bytes.size());
+        outputs[lane] = bytes.data() + first;
+        counts[lane] = std::min(segment, bytes.size() - first);
+    }
+
+    // lanes are independent so the four table lookups per step overlap
+    const Huffman::Entry* entries = table.data();
+    const std::size_t common = *std::min_element(counts.begin(), counts.end());
+    for (std::size_t i = 0; i < common; i += 5) {
+        const std::size_t steps = std::min<std::size_t>(5, common - i);
+        for (Lane& lane : lanes)
+            lane.refill();
+        for (std::size_t step = 0; step < steps; ++step) {
+            outputs[0][i + step] = lanes[0].decode(entries);
+            outputs[1][i + step] = lanes[1].decode(entries);
+            outputs[2][i + step] = lanes[2].decode(entries);
+            outputs[3][i + step] = lanes[3].decode(entries);
+        }
+    }
+    for (std::size_t lane = 0; lane < Huffman::lanes; ++lane) {
+        for (std::size_t i = common; i < counts[lane]; ++i) {
+            lanes[lane].refill();
+            outputs[lane][i] = lanes[lane].decode(entries);
+        }
+    }
+}
+
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+
+#include "DataStream/DataStream.hpp"
+#include "DataStream/Encoding.hpp"
+
+
+
+
+namespace DataStream {
+
+template <typename T>
+concept QuantizedFloat = std::is_same_v<T, float> || std::is_same_v<T, double>;
+
+template <typename I>
+concept QuantizedInteger = std::is_same_v<I, std::int8_t> || std::is_same_v<I, std::int16_t> || std::is_same_v<I, std::int32_t>;
+
+
+// writes double scale, double offset, then every value as I = round((value - offset) / scale),
+// values inside [offset + min(I) * scale, offset + max(I) * scale] decode with |error| <= scale / 2
+// (plus the rounding of the decoded value to T), values outside are clamped and NaN is written as 0
+template <QuantizedInteger I, typename S, QuantizedFloat T>
+inline void write_quantized(S& stream, std::span<const T> values, double scale, double offset = 0.0) {
+    if (!(scale > 0.0) || !std::isfinite(scale) || !std::isfinite(offset))
+        throw std::invalid_argument("invalid quantization scale or offset");
+    stream << scale << offset;
+
+    constexpr double low = std::numeric_limits<I>::min(), high = std::numeric_limits<I>::max();
+    const double inverse = 1.0 / scale;
+    std::array<I, 512> chunk;
+    for (std::size_t i = 0; i < values.size(); i += chunk.size()) {
+        const std::size_t count = std::min(chunk.size(), values.size() - i);
+        // branch free so the conversion vectorizes
+        for (std::size_t j = 0; j < count; ++j) {
+            double x = (static_cast<double>(values[i + j]) - offset) * inverse;
+            x = x != x ? 0.0 : x;
+            x = std::min(std::max(x, low), high);
+            chunk[j] = static_cast<I>(x + (x < 0.0 ? -0.5 : 0.5));
+        }
+        stream << std::span<const I>(chunk.data(), count);
+    }
+}
+
+template <QuantizedInteger I, typename S, QuantizedFloat T>
+inline void read_quantized(S& stream, std::span<T> values) {
+    double scale, offset;
+    stream >> scale >> offset;
+
+    std::array<I, 512> chunk;
+    for (std::size_t i = 0; i < values.size(); i += chunk.size()) {
+        const std::size_t count = std::min(chunk.size(), values.size() - i);
+        stream >> std::span<I>(chunk.data(), count);
+        for (std::size_t j = 0; j < count; ++j)
+            values[i + j] = static_cast<T>(offset + chunk[j] * scale);
+    }
+}
+
+
+template <QuantizedFloat T>
+struct FloatLayout {
+    using Bits = std::conditional_t<std::is_same_v<T, float>, std::uint32_t, std::uint64_t>;
+    static constexpr unsigned mantissa = std::numeric_limits<T>::digits - 1;
+    static constexpr unsigned exponent = sizeof(T) * 8 - 1 - mantissa;
+};
+
+// writes uint8 mantissa bits, then sign, exponent and the top `mantissa_bits` mantissa bits of every value
+// bit packed, rounded to nearest, normal values decode with relative |error| <= 2^-(mantissa_bits + 1),
+// infinities and NaN are kept, finite values that would round up to infinity are truncated instead
+template <typename S, QuantizedFloat T>
+inline void write_truncated(S& stream, std::span<const T> values, unsigned mantissa_bits) {
+    using Layout = FloatLayout<T>;
+    using Bits = typename Layout::Bits;
+    if (mantissa_bits == 0 || mantissa_bits > Layout::mantissa)
+        throw std::invalid_argument("invalid mantissa bits");
+    stream << static_cast<std::uint8_t>(mantissa_bits);
+
+    const unsigned dropped = Layout::mantissa - mantissa_bits;
+    const unsigned width = 1 + Layout::exponent + mantissa_bits;
+    const Bits exponent_mask = ((Bits(1) << Layout::exponent) - 1) << Layout::mantissa;
+    const Bits half = dropped ? Bits(1) << (dropped - 1) : 0;
+
+    std::array<Bits, 512> chunk;
+    DataStream::BitWriter<S> writer(stream);
+    for (std::size_t i = 0; i < values.size(); i += chunk.size()) {
+        const std::size_t count = std::min(chunk.size(), values.size() - i);
+        for (std::size_t j = 0; j < count; ++j) {
+            const Bits bits = std::bit_cast<Bits>(values[i + j]);
+            const Bits rounded = bits + half;
+            const bool special = (bits & exponent_mask) == exponent_mask;
+            const bool overflow = (rounded & exponent_mask) == exponent_mask;
+            Bits kept = (special || overflow ? bits : rounded) >> dropped;
+            // a NaN must keep a mantissa bit to stay NaN
+            kept |= special && (bits & ((Bits(1) << Layout::mantissa) - 1)) ? Bits(1) << (mantissa_bits - 1) : 0;
+            chunk[j] = kept;
+        }
+        for (std::size_t j = 0; j < count; ++j)
+            writer.write(chunk[j], width);
+    }
+    writer.flush();
+}
+
+template <typename S, QuantizedFloat T>
+inline void read_truncated(S& stream, std::span<T> values) {
+    using Layout = FloatLayout<T>;
+    using Bits = typename Layout::Bits;
+    std::uint8_t mantissa_bits;
+    stream >> mantissa_bits;
+    if (mantissa_bits == 0 || mantissa_bits > Layout::mantissa)
+        throw std::runtime_error("invalid mantissa bits");
+
+    const unsigned dropped = Layout::mantissa - mantissa_bits;
+    const unsigned width = 1 + Layout::exponent + mantissa_bits;
+    DataStream::BitReader<S> reader(stream, DataStream::bit_packed_size(values.size(), width));
+    for (T& value : values)
+        value = std::bit_cast<T>(static_cast<Bits>(reader.read(width) << dropped));
+    reader.finish();
+}
+
+}
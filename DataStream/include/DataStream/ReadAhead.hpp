@@ -0,0 +1,191 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <ios>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "DataStream/DataStream.hpp"
+#include "DataStream/Descriptor.hpp"
+
+
+
+
+namespace DataStream {
+
+// sequential reader over a file descriptor (not owned) with a helper thread that keeps up to `buffers`
+// buffers filled ahead of the caller, so decoding one buffer overlaps reading the next ones
+//
+// files are hinted with posix_fadvise(SEQUENTIAL) and WILLNEED for the range being read ahead, on pipes
+// and sockets every read() is passed on as soon as it returns, so request/response traffic does not wait
+// for a full buffer, read errors of the helper thread are rethrown once the caller reaches them, on a
+// pipe or socket the destructor waits for the helper's pending read() to return
+template <std::endian endiannes = std::endian::native>
+class ReadAheadFileStream : public DataStream::StreamOperators<ReadAheadFileStream<endiannes>, endiannes, false, true> {
+private:
+    friend DataStream::StreamOperators<ReadAheadFileStream<endiannes>, endiannes, false, true>;
+
+    struct Ready {
+        std::size_t buffer;
+        std::size_t size; // 0 at the end of the file
+    };
+
+    int fd = -1;
+    std::vector<std::vector<std::uint8_t>> buffers;
+    std::size_t current = 0;
+    std::size_t position = 0;
+    std::size_t size = 0;
+    bool holding = false; // whether `current` belongs to the caller
+    bool end = false;
+
+    std::mutex mutex;
+    std::condition_variable filled; // a buffer is ready, or the helper stopped
+    std::condition_variable emptied; // a buffer was handed back, or the stream is closing
+    std::deque<Ready> ready;
+    std::vector<std::size_t> free_buffers;
+    bool stopping = false;
+    std::exception_ptr error;
+    std::thread helper;
+
+    inline void work(off_t offset) {
+        const std::size_t capacity = this->buffers.front().size();
+        for (;;) {
+            std::size_t buffer;
+            {
+                std::unique_lock lock(this->mutex);
+                this->emptied.wait(lock, [&] { return this->stopping || !this->free_buffers.empty(); });
+                if (this->stopping)
+                    return;
+                buffer = this->free_buffers.back();
+                this->free_buffers.pop_back();
+            }
+
+            if (offset >= 0) {
+                ::posix_fadvise(this->fd, offset, static_cast<off_t>(capacity * this->buffers.size()), POSIX_FADV_WILLNEED);
+                offset += static_cast<off_t>(capacity);
+            }
+
+            std::size_t size = 0;
+            bool eof = false;
+            std::exception_ptr failure;
+            try {
+                while (size < capacity) {
+                    const std::size_t read = DataStream::read_some(this->fd, this->buffers[buffer].data() + size, capacity - size);
+                    if (!read) {
+                        eof = true;
+                        break;
+                    }
+                    size += read;
+                    // a pipe or socket may never fill the buffer, what arrived is handed over right away
+                    if (offset < 0)
+                        break;
+                }
+            } catch (...) {
+                failure = std::current_exception();
+            }
+
+            std::lock_guard lock(this->mutex);
+            if (size)
+                this->ready.push_back({ buffer, size });
+            if (failure)
+                this->error = failure;
+            else if (eof)
+                this->ready.push_back({ buffer, 0 });
+            this->filled.notify_one();
+            if (failure || eof)
+                return;
+        }
+    }
+
+    // hands the current buffer back and takes the next ready one, false at the end of the file
+    inline bool next() {
+        std::unique_lock lock(this->mutex);
+        if (this->holding) {
+            this->free_buffers.push_back(this->current);
+            this->holding = false;
+            this->emptied.notify_one();
+        }
+        this->filled.wait(lock, [&] { return !this->ready.empty() || this->error; });
+        if (this->ready.empty())
+            std::rethrow_exception(this->error);
+        const Ready next = this->ready.front();
+        this->ready.pop_front();
+        if (!next.size) {
+            this->end = true;
+            return false;
+        }
+        this->current = next.buffer;
+        this->position = 0;
+        this->size = next.size;
+        this->holding = true;
+        return true;
+    }
+
+    // consumes `size` bytes, copied into `data` unless it is null
+    inline void read(std::uint8_t* data, std::size_t size) {
+        while (size) {
+            if (this->position == this->size && (this->end || !this->next()))
+                throw std::ios_base::failure("file read failed, unexpected end of file");
+            const std::size_t count = std::min(size, this->size - this->position);
+            if (data) {
+                std::copy_n(this->buffers[this->current].data() + this->position, count, data);
+                data += count;
+            }
+            this->position += count;
+            size -= count;
+        }
+    }
+
+
+public:
+    explicit ReadAheadFileStream(int fd, std::size_t buffer_size = 1024 * 1024, std::size_t buffers = 4)
+        : fd(fd)
+    {
+        if (this->fd < 0)
+            throw std::invalid_argument("invalid file descriptor");
+        if (buffer_size == 0 || buffers < 2)
+            throw std::invalid_argument("need at least 2 buffers of a positive size");
+        this->buffers.assign(buffers, std::vector<std::uint8_t>(buffer_size));
+        for (std::size_t b = buffers; b-- > 0;)
+            this->free_buffers.push_back(b);
+
+        // pipes and sockets have no position and take no hints
+        const off_t offset = ::lseek(this->fd, 0, SEEK_CUR);
+        if (offset >= 0)
+            ::posix_fadvise(this->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        this->helper = std::thread([this, offset] { this->work(offset); });
+    }
+
+    ~ReadAheadFileStream() {
+        {
+            std::lock_guard lock(this->mutex);
+            this->stopping = true;
+        }
+        this->emptied.notify_one();
+        this->helper.join();
+    }
+
+    ReadAheadFileStream(const ReadAheadFileStream& o) = delete;
+    ReadAheadFileStream& operator=(const ReadAheadFileStream& o) = delete;
+    ReadAheadFileStream(ReadAheadFileStream&& o) = delete;
+    ReadAheadFileStream& operator=(ReadAheadFileStream&& o) = delete;
+
+    inline void skip(std::size_t count) {
+        this->read(nullptr, count);
+    }
+};
+
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "DataStream/DataStream.hpp"
+
+
+
+
+namespace DataStream {
+
+// writes a fixed buffer from its end towards its beginning, every write lands in front of the
+// previous ones, so nested messages are written children first and a length prefix is emitted
+// after its payload, when the payload size is known:
+//   auto end = w.size(); w << payload; w << static_cast<uint32_t>(w.size() - end);
+// a single write keeps its own byte order, so encoders that emit a value with one span write
+// (write_varint()) can be used directly
+template <std::endian endiannes = std::endian::native>
+class ReverseStream {
+private:
+    std::span<std::uint8_t> data;
+    std::uint8_t* underlying_data = nullptr;
+    std::size_t index = 0; // first written byte, the buffer is filled in [index, data.size())
+
+    template <typename T>
+    inline T byteswap(T value) const {
+        return endiannes != std::endian::native ? DataStream::byteswap(value) : value;
+    }
+
+    inline void reserve(std::size_t size) {
+        if (size > this->index)
+            throw std::out_of_range("index out of range");
+        this->index -= size;
+    }
+
+
+public:
+    template <typename Container>
+    requires (!std::is_array_v<Container> && std::is_convertible_v<typename Container::value_type, std::uint8_t>)
+    ReverseStream(Container& container)
+        : data(std::span<std::uint8_t>(container.data(), container.size())),
+        underlying_data(this->data.data()),
+        index(this->data.size())
+    {}
+
+    template <std::size_t N>
+    ReverseStream(std::uint8_t (&array)[N])
+        : data(array, N),
+        underlying_data(this->data.data()),
+        index(N)
+    {}
+
+    ~ReverseStream() = default;
+
+    ReverseStream(const ReverseStream& o) = default;
+    ReverseStream& operator=(const ReverseStream& o) = default;
+
+    ReverseStream(ReverseStream&& o) noexcept
+        : data(std::exchange(o.data, {})),
+        underlying_data(std::exchange(o.underlying_data, nullptr)),
+        index(std::exchange(o.index, 0))
+    {}
+
+    ReverseStream& operator=(ReverseStream&& o) noexcept {
+        if (this == &o) return *this;
+        data = std::exchange(o.data, {});
+        underlying_data = std::exchange(o.underlying_data, nullptr);
+        index = std::exchange(o.index, 0);
+        return *this;
+    }
+
+    template <typename T>
+    requires std::is_arithmetic_v<T>
+    ReverseStream& operator<<(const T& value) {
+        this->reserve(sizeof(T));
+        const T output = this->byteswap(value);
+        std::copy_n(reinterpret_cast<const std::uint8_t*>(&output), sizeof(T), this->underlying_data + this->index);
+        return *this;
+    }
+
+    // the values keep their order, the whole span lands in front of the previous writes
+    template <typename T>
+    requires std::is_arithmetic_v<T>
+    ReverseStream& operator<<(std::span<const T> values) {
+        this->reserve(values.size_bytes());
+        std::uint8_t* output = this->underlying_data + this->index;
+        if constexpr (endiannes == std::endian::native || sizeof(T) == 1) {
+            std::copy_n(reinterpret_cast<const std::uint8_t*>(values.data()), values.size_bytes(), output);
+        } else {
+            for (std::size_t i = 0; i < values.size(); ++i) {
+                const T value = this->byteswap(values[i]);
+                std::copy_n(reinterpret_cast<const std::uint8_t*>(&value), sizeof(T), output + i * sizeof(T));
+            }
+        }
+        return *this;
+    }
+
+    // number of bytes written so far, differences of size() give the size of what was written in between
+    inline std::size_t size() const { return this->data.size() - this->index; }
+
+    // the finished bytes, at the end of the buffer
+    inline std::span<const std::uint8_t> view() const {
+        return std::span<const std::uint8_t>(this->underlying_data + this->index, this->size());
+    }
+
+    inline void clear() { this->index = this->data.size(); }
+};
+
+}
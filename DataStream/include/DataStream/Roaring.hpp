@@ -0,0 +1,499 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#include "DataStream/DataStream.hpp"
+#include "DataStream/Encoding.hpp"
+
+
+
+
+namespace DataStream {
+
+struct RoaringContainer {
+RoaringContainer() = delete;
+RoaringContainer(const RoaringContainer& o) = delete;
+RoaringContainer(RoaringContainer&& o) noexcept = delete;
+RoaringContainer& operator=(const RoaringContainer& o) = delete;
+RoaringContainer& operator=(RoaringContainer&& o) noexcept = delete;
+~RoaringContainer() = default;
+
+using Type = std::uint8_t;
+static const Type
+    Array = 0, // sorted uint16 values, at most 4096 of them
+    Bitmap = 1, // 65536 bits as 1024 uint64 words
+    Run = 2; // sorted { start, length - 1 } uint16 pairs
+
+static constexpr std::uint32_t array_limit = 4096;
+static constexpr std::size_t words = 1024;
+};
+
+
+// read only access to one container, either owned (native endianness) or inside serialized bytes
+template <std::endian endiannes = std::endian::native>
+struct RoaringContainerView {
+    RoaringContainer::Type type = RoaringContainer::Array;
+    std::uint32_t cardinality = 0;
+    const std::uint8_t* data = nullptr;
+    std::size_t runs = 0;
+
+    inline std::uint16_t value(std::size_t i) const { return DataStream::load<std::uint16_t, endiannes>(this->data + 2 * i); }
+    inline std::uint64_t word(std::size_t i) const { return DataStream::load<std::uint64_t, endiannes>(this->data + 8 * i); }
+    inline std::uint16_t run_start(std::size_t i) const { return this->value(2 * i); }
+    inline std::uint32_t run_end(std::size_t i) const { return std::uint32_t(this->value(2 * i)) + this->value(2 * i + 1); } // inclusive
+
+    inline bool contains(std::uint16_t low) const {
+        if (this->type == RoaringContainer::Bitmap)
+            return (this->word(low >> 6) >> (low & 63)) & 1;
+
+        const bool run = this->type == RoaringContainer::Run;
+        std::size_t first = 0, count = run ? this->runs : this->cardinality;
+        while (count) {
+            const std::size_t half = count / 2;
+            if ((run ? this->run_start(first + half) : this->value(first + half)) <= low) {
+                first += half + 1;
+                count -= half + 1;
+            } else {
+                count = half;
+            }
+        }
+        if (!first)
+            return false;
+        return run ? low <= this->run_end(first - 1) : this->value(first - 1) == low;
+    }
+
+    // whether the container data is consistent: sorted values, runs ending at or below 0xFFFF
+    // without overlap, and a cardinality matching the data, checked before decoding untrusted input
+    inline bool valid() const {
+        if (this->type == RoaringContainer::Array) {
+            if (this->cardinality > RoaringContainer::array_limit)
+                return false;
+            for (std::size_t i = 1; i < this->cardinality; ++i)
+                if (this->value(i) <= this->value(i - 1))
+                    return false;
+            return true;
+        }
+        if (this->type == RoaringContainer::Bitmap) {
+            std::uint32_t total = 0;
+            for (std::size_t i = 0; i < RoaringContainer::words; ++i)
+                total += std::popcount(this->word(i));
+            return total == this->cardinality;
+        }
+        if (this->type != RoaringContainer::Run)
+            return false;
+        std::uint32_t total = 0;
+        for (std::size_t r = 0; r < this->runs; ++r) {
+            if (this->run_end(r) > 0xFFFF || (r && this->run_start(r) <= this->run_end(r - 1)))
+                return false;
+            total += this->run_end(r) - this->run_start(r) + 1;
+        }
+        return total == this->cardinality;
+    }
+
+    inline void words(std::array<std::uint64_t, RoaringContainer::words>& out) const {
+        if (this->type == RoaringContainer::Bitmap) {
+            for (std::size_t i = 0; i < out.size(); ++i)
+                out[i] = this->word(i);
+            return;
+        }
+        out.fill(0);
+        if (this->type == RoaringContainer::Array) {
+            for (std::size_t i = 0; i < this->cardinality; ++i)
+                out[this->value(i) >> 6] |= std::uint64_t(1) << (this->value(i) & 63);
+            return;
+        }
+        for (std::size_t r = 0; r < this->runs; ++r)
+            for (std::uint32_t v = this->run_start(r); v <= this->run_end(r); ++v)
+                out[v >> 6] |= std::uint64_t(1) << (v & 63);
+    }
+
+    template <typename F>
+    inline void for_each(F&& f) const {
+        if (this->type == RoaringContainer::Array) {
+            for (std::size_t i = 0; i < this->cardinality; ++i)
+                f(this->value(i));
+        } else if (this->type == RoaringContainer::Bitmap) {
+            for (std::size_t i = 0; i < RoaringContainer::words; ++i)
+                for (std::uint64_t w = this->word(i); w; w &= w - 1)
+                    f(static_cast<std::uint16_t>(i * 64 + std::countr_zero(w)));
+        } else {
+            for (std::size_t r = 0; r < this->runs; ++r)
+                for (std::uint32_t v = this->run_start(r); v <= this->run_end(r); ++v)
+                    f(static_cast<std::uint16_t>(v));
+        }
+    }
+};
+
+
+// compressed set of uint32 values, split by their high 16 bits into array, bitmap or run containers,
+// serialized as:
+//   uint32 containers, { uint16 key, uint8 type, uint32 cardinality, uint32 offset } per container,
+//   container data at the offsets (relative to the end of the descriptors):
+//   array: uint16 values, bitmap: 1024 uint64 words, run: uint16 runs + { uint16 start, uint16 length - 1 } pairs
+class RoaringBitmap {
+private:
+    struct Entry {
+        std::uint16_t key = 0;
+        RoaringContainer::Type type = RoaringContainer::Array;
+        std::uint32_t cardinality = 0;
+        std::vector<std::uint16_t> values; // array values or run pairs
+        std::vector<std::uint64_t> words;
+    };
+
+    std::vector<Entry> entries; // sorted by key
+
+    static constexpr std::size_t descriptor_size = 2 + 1 + 4 + 4;
+
+    static inline RoaringContainerView<> view(const Entry& entry) {
+        RoaringContainerView<> view;
+        view.type = entry.type;
+        view.cardinality = entry.cardinality;
+        view.data = entry.type == RoaringContainer::Bitmap
+            ? reinterpret_cast<const std::uint8_t*>(entry.words.data())
+            : reinterpret_cast<const std::uint8_t*>(entry.values.data());
+        view.runs = entry.type == RoaringContainer::Run ? entry.values.size() / 2 : 0;
+        return view;
+    }
+
+    static inline std::size_t data_size(const Entry& entry) {
+        switch (entry.type) {
+            case RoaringContainer::Array: return entry.values.size() * sizeof(std::uint16_t);
+            case RoaringContainer::Bitmap: return RoaringContainer::words * sizeof(std::uint64_t);
+            default: return sizeof(std::uint16_t) + entry.values.size() * sizeof(std::uint16_t);
+        }
+    }
+
+    static inline void to_bitmap(Entry& entry) {
+        std::array<std::uint64_t, RoaringContainer::words> words;
+        view(entry).words(words);
+        entry.words.assign(words.begin(), words.end());
+        entry.values.clear();
+        entry.values.shrink_to_fit();
+        entry.type = RoaringContainer::Bitmap;
+    }
+
+    static inline void to_array(Entry& entry) {
+        std::vector<std::uint16_t> values;
+        values.reserve(entry.cardinality);
+        view(entry).for_each([&](std::uint16_t v) { values.push_back(v); });
+        entry.values = std::move(values);
+        entry.words.clear();
+        entry.words.shrink_to_fit();
+        entry.type = RoaringContainer::Array;
+    }
+
+    static inline Entry from_words(std::uint16_t key, const std::array<std::uint64_t, RoaringContainer::words>& words) {
+        Entry entry;
+        entry.key = key;
+        entry.type = RoaringContainer::Bitmap;
+        for (std::uint64_t word : words)
+            entry.cardinality += std::popcount(word);
+        entry.words.assign(words.begin(), words.end());
+        if (entry.cardinality <= RoaringContainer::array_limit)
+            to_array(entry);
+        return entry;
+    }
+
+    template <std::endian A, std::endian B>
+    static inline Entry intersect(std::uint16_t key, const RoaringContainerView<A>& a, const RoaringContainerView<B>& b) {
+        if (a.type == RoaringContainer::Array || b.type == RoaringContainer::Array) {
+            Entry entry;
+            entry.key = key;
+            auto probe = [&](const auto& array, const auto& other) {
+                array.for_each([&](std::uint16_t v) {
+                    if (other.contains(v))
+                        entry.values.push_back(v);
+                });
+            };
+            if (a.type == RoaringContainer::Array && (b.type != RoaringContainer::Array || a.cardinality <= b.cardinality))
+                probe(a, b);
+            else
+                probe(b, a);
+            entry.cardinality = static_cast<std::uint32_t>(entry.values.size());
+            return entry;
+        }
+
+        std::array<std::uint64_t, RoaringContainer::words> x, y;
+        a.words(x);
+        b.words(y);
+        for (std::size_t i = 0; i < x.size(); ++i)
+            x[i] &= y[i];
+        return from_words(key, x);
+    }
+
+    inline std::vector<Entry>::iterator find(std::uint16_t key) {
+        return std::lower_bound(this->entries.begin(), this->entries.end(), key,
+            [](const Entry& entry, std::uint16_t k) { return entry.key < k; });
+    }
+
+public:
+    RoaringBitmap() = default;
+    ~RoaringBitmap() = default;
+
+    inline std::size_t containers() const { return this->entries.size(); }
+    inline std::uint16_t key(std::size_t i) const { return this->entries[i].key; }
+    inline RoaringContainerView<> container(std::size_t i) const { return view(this->entries[i]); }
+
+    inline void add(std::uint32_t value) {
+        const std::uint16_t key = value >> 16, low = value & 0xFFFF;
+        auto it = this->find(key);
+        if (it == this->entries.end() || it->key != key) {
+            it = this->entries.insert(it, Entry{});
+            it->key = key;
+        }
+        Entry& entry = *it;
+        if (entry.type == RoaringContainer::Run) {
+            if (view(entry).contains(low))
+                return;
+            if (entry.cardinality < RoaringContainer::array_limit)
+                to_array(entry);
+            else
+                to_bitmap(entry);
+        }
+
+        if (entry.type == RoaringContainer::Bitmap) {
+            std::uint64_t& word = entry.words[low >> 6];
+            const std::uint64_t bit = std::uint64_t(1) << (low & 63);
+            entry.cardinality += !(word & bit);
+            word |= bit;
+            return;
+        }
+
+        auto position = std::lower_bound(entry.values.begin(), entry.values.end(), low);
+        if (position != entry.values.end() && *position == low)
+            return;
+        entry.values.insert(position, low);
+        if (++entry.cardinality > RoaringContainer::array_limit)
+            to_bitmap(entry);
+    }
+
+    inline bool contains(std::uint32_t value) const {
+        auto it = std::lower_bound(this->entries.begin(), this->entries.end(), std::uint16_t(value >> 16),
+            [](const Entry& entry, std::uint16_t k) { return entry.key < k; });
+        return it != this->entries.end() && it->key == (value >> 16) && view(*it).contains(value & 0xFFFF);
+    }
+
+    inline std::uint64_t cardinality() const {
+        std::uint64_t total = 0;
+        for (const Entry& entry : this->entries)
+            total += entry.cardinality;
+        return total;
+    }
+
+    // converts every container to whichever of array, bitmap or run serializes smallest
+    inline void optimize() {
+        for (Entry& entry : this->entries) {
+            std::vector<std::uint16_t> runs;
+            view(entry).for_each([&](std::uint16_t v) {
+                if (!runs.empty() && std::uint32_t(runs[runs.size() - 2]) + runs.back() + 1 == v)
+                    ++runs.back();
+                else
+                    runs.insert(runs.end(), { v, 0 });
+            });
+
+            const std::size_t run_size = sizeof(std::uint16_t) + runs.size() * sizeof(std::uint16_t);
+            const std::size_t array_size = entry.cardinality * sizeof(std::uint16_t);
+            const std::size_t bitmap_size = RoaringContainer::words * sizeof(std::uint64_t);
+            if (run_size < std::min(array_size, bitmap_size)) {
+                entry.values = std::move(runs);
+                entry.words.clear();
+                entry.words.shrink_to_fit();
+                entry.type = RoaringContainer::Run;
+            } else if (array_size <= bitmap_size && entry.type != RoaringContainer::Array) {
+                to_array(entry);
+            } else if (array_size > bitmap_size && entry.type != RoaringContainer::Bitmap) {
+                to_bitmap(entry);
+            }
+        }
+    }
+
+    inline std::vector<std::uint32_t> values() const {
+        std::vector<std::uint32_t> values;
+        values.reserve(this->cardinality());
+        for (const Entry& entry : this->entries)
+            view(entry).for_each([&](std::uint16_t low) { values.push_back((std::uint32_t(entry.key) << 16) | low); });
+        return values;
+    }
+
+    // intersection of any two bitmaps providing containers(), key(i) and container(i)
+    template <typename A, typename B>
+    static inline RoaringBitmap intersection(const A& a, const B& b) {
+        RoaringBitmap result;
+        std::size_t i = 0, j = 0;
+        while (i < a.containers() && j < b.containers()) {
+            if (a.key(i) < b.key(j)) {
+                ++i;
+            } else if (b.key(j) < a.key(i)) {
+                ++j;
+            } else {
+                Entry entry = intersect(a.key(i), a.container(i), b.container(j));
+                if (entry.cardinality)
+                    result.entries.push_back(std::move(entry));
+                ++i;
+                ++j;
+            }
+        }
+        return result;
+    }
+
+    inline RoaringBitmap operator&(const RoaringBitmap& o) const { return intersection(*this, o); }
+
+    // exact number of bytes write() produces
+    inline std::size_t size_bytes() const {
+        std::size_t size = sizeof(std::uint32_t) + this->entries.size() * descriptor_size;
+        for (const Entry& entry : this->entries)
+            size += data_size(entry);
+        return size;
+    }
+
+    template <typename S>
+    inline void write(S& stream) const {
+        stream << static_cast<std::uint32_t>(this->entries.size());
+        std::uint32_t offset = 0;
+        for (const Entry& entry : this->entries) {
+            stream << entry.key << entry.type << entry.cardinality << offset;
+            offset += static_cast<std::uint32_t>(data_size(entry));
+        }
+        for (const Entry& entry : this->entries) {
+            if (entry.type == RoaringContainer::Bitmap) {
+                stream << std::span<const std::uint64_t>(entry.words);
+            } else {
+                if (entry.type == RoaringContainer::Run)
+                    stream << static_cast<std::uint16_t>(entry.values.size() / 2);
+                stream << std::span<const std::uint16_t>(entry.values);
+            }
+        }
+    }
+
+    template <typename S>
+    static inline RoaringBitmap read(S& stream) {
+        RoaringBitmap bitmap;
+        std::uint32_t count;
+        stream >> count;
+        if (count > 65536) // one container per distinct 16 bit key
+            throw std::runtime_error("invalid roaring container count");
+        std::vector<std::uint32_t> offsets(count);
+        bitmap.entries.resize(count);
+        for (std::uint32_t i = 0; i < count; ++i) {
+            Entry& entry = bitmap.entries[i];
+            stream >> entry.key >> entry.type >> entry.cardinality >> offsets[i];
+            if (entry.type > RoaringContainer::Run || entry.cardinality > 65536 || (i && entry.key <= bitmap.entries[i - 1].key))
+                throw std::runtime_error("invalid roaring container");
+        }
+
+        std::uint32_t offset = 0;
+        for (std::uint32_t i = 0; i < count; ++i) {
+            Entry& entry = bitmap.entries[i];
+            if (offsets[i] != offset)
+                throw std::runtime_error("invalid roaring container offset");
+            if (entry.type == RoaringContainer::Bitmap) {
+                entry.words.resize(RoaringContainer::words);
+                stream >> std::span<std::uint64_t>(entry.words);
+            } else if (entry.type == RoaringContainer::Array) {
+                if (entry.cardinality > RoaringContainer::array_limit)
+                    throw std::runtime_error("invalid roaring array container");
+                entry.values.resize(entry.cardinality);
+                stream >> std::span<std::uint16_t>(entry.values);
+            } else {
+                std::uint16_t runs;
+                stream >> runs;
+                entry.values.resize(std::size_t(runs) * 2);
+                stream >> std::span<std::uint16_t>(entry.values);
+            }
+            if (!view(entry).valid())
+                throw std::runtime_error("invalid roaring container");
+            offset += static_cast<std::uint32_t>(data_size(entry));
+        }
+        return bitmap;
+    }
+};
+
+
+// zero copy view over a RoaringBitmap serialized with the given stream endianness
+template <std::endian endiannes = std::endian::native>
+class FrozenRoaringBitmap {
+private:
+    static constexpr std::size_t descriptor_size = 2 + 1 + 4 + 4;
+
+    const std::uint8_t* descriptors = nullptr;
+    std::span<const std::uint8_t> data;
+    std::uint32_t count = 0;
+
+    inline const std::uint8_t* descriptor(std::size_t i) const { return this->descriptors + i * descriptor_size; }
+
+public:
+    explicit FrozenRoaringBitmap(std::span<const std::uint8_t> bytes) {
+        if (bytes.size() < sizeof(std::uint32_t))
+            throw std::out_of_range("roaring bitmap truncated");
+        this->count = DataStream::load<std::uint32_t, endiannes>(bytes.data());
+        if ((bytes.size() - sizeof(std::uint32_t)) / descriptor_size < this->count)
+            throw std::out_of_range("roaring bitmap truncated");
+        this->descriptors = bytes.data() + sizeof(std::uint32_t);
+        this->data = bytes.subspan(sizeof(std::uint32_t) + this->count * descriptor_size);
+
+        for (std::size_t i = 0; i < this->count; ++i) {
+            const RoaringContainerView<endiannes> view = this->container(i);
+            const std::size_t offset = view.data - this->data.data();
+            const std::size_t size = view.type == RoaringContainer::Bitmap ? RoaringContainer::words * 8
+                : view.type == RoaringContainer::Array ? view.cardinality * 2
+                : view.runs * 4;
+            if (view.type > RoaringContainer::Run || offset > this->data.size() || size > this->data.size() - offset)
+                throw std::out_of_range("roaring container out of range");
+            if (!view.valid() || (i && this->key(i) <= this->key(i - 1)))
+                throw std::runtime_error("invalid roaring container");
+        }
+    }
+
+    inline std::size_t containers() const { return this->count; }
+    inline std::uint16_t key(std::size_t i) const { return DataStream::load<std::uint16_t, endiannes>(this->descriptor(i)); }
+
+    inline RoaringContainerView<endiannes> container(std::size_t i) const {
+        const std::uint8_t* d = this->descriptor(i);
+        RoaringContainerView<endiannes> view;
+        view.type = d[2];
+        view.cardinality = DataStream::load<std::uint32_t, endiannes>(d + 3);
+        const std::uint32_t offset = DataStream::load<std::uint32_t, endiannes>(d + 7);
+        if (offset >= this->data.size())
+            throw std::out_of_range("roaring container out of range");
+        view.data = this->data.data() + offset;
+        if (view.type == RoaringContainer::Run) {
+            if (offset + sizeof(std::uint16_t) > this->data.size())
+                throw std::out_of_range("roaring container out of range");
+            view.runs = DataStream::load<std::uint16_t, endiannes>(view.data);
+            view.data += sizeof(std::uint16_t);
+        }
+        return view;
+    }
+
+    inline bool contains(std::uint32_t value) const {
+        std::size_t first = 0, n = this->count;
+        while (n) {
+            const std::size_t half = n / 2;
+            if (this->key(first + half) < (value >> 16)) {
+                first += half + 1;
+                n -= half + 1;
+            } else {
+                n = half;
+            }
+        }
+        return first < this->count && this->key(first) == (value >> 16) && this->container(first).contains(value & 0xFFFF);
+    }
+
+    inline std::uint64_t cardinality() const {
+        std::uint64_t total = 0;
+        for (std::size_t i = 0; i < this->count; ++i)
+            total += DataStream::load<std::uint32_t, endiannes>(this->descriptor(i) + 3);
+        return total;
+    }
+
+    template <typename B>
+    inline RoaringBitmap operator&(const B& o) const { return RoaringBitmap::intersection(*this, o); }
+};
+
+}
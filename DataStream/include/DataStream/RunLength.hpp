@@ -0,0 +1,179 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+
+#include "DataStream/DataStream.hpp"
+#include "DataStream/Encoding.hpp"
+
+
+
+
+namespace DataStream {
+
+// number of leading elements whose bits equal `value`, whole 32 byte blocks are compared
+// without early exit so the compiler can vectorize the scan
+template <typename T>
+requires std::is_arithmetic_v<T>
+inline std::size_t run_length(const T* data, std::size_t count, T value) {
+    using Bits =
+        std::conditional_t<sizeof(T) == 1, std::uint8_t,
+        std::conditional_t<sizeof(T) == 2, std::uint16_t,
+        std::conditional_t<sizeof(T) == 4, std::uint32_t,
+        std::uint64_t
+    >>>;
+    static_assert(sizeof(T) == sizeof(Bits), "unsupported value width");
+    constexpr std::size_t block = 32 / sizeof(T);
+
+    const Bits bits = std::bit_cast<Bits>(value);
+    std::size_t i = 0;
+    for (; i + block <= count; i += block) {
+        bool equal = true;
+        for (std::size_t j = 0; j < block; ++j)
+            equal &= std::bit_cast<Bits>(data[i + j]) == bits;
+        if (!equal)
+            break;
+    }
+    while (i < count && std::bit_cast<Bits>(data[i]) == bits)
+        ++i;
+    return i;
+}
+
+// index of the first zero byte, or `count` if there is none
+inline std::size_t find_zero(const std::uint8_t* data, std::size_t count) {
+    constexpr std::size_t block = 32;
+
+    std::size_t i = 0;
+    for (; i + block <= count; i += block) {
+        bool nonzero = true;
+        for (std::size_t j = 0; j < block; ++j)
+            nonzero &= data[i + j] != 0;
+        if (!nonzero)
+            break;
+    }
+    while (i < count && data[i] != 0)
+        ++i;
+    return i;
+}
+
+
+// format: varint count, then tokens of varint header, header & 1 marks a run of
+// (header >> 1) copies of the single value that follows, otherwise (header >> 1) literal values follow
+template <typename S, typename T>
+requires std::is_arithmetic_v<T>
+inline void write_runs(S& stream, std::span<const T> values, std::size_t minimum_run = 3) {
+    minimum_run = std::max<std::size_t>(minimum_run, 2);
+    DataStream::write_varint(stream, values.size());
+
+    std::size_t literal = 0;
+    std::size_t i = 0;
+    while (i < values.size()) {
+        // inside literal stretches a single compare rules out a run before any block scan starts
+        if (i + 1 < values.size() && std::memcmp(&values[i], &values[i + 1], sizeof(T)) != 0) {
+            ++i;
+            continue;
+        }
+        const std::size_t run = DataStream::run_length(values.data() + i, values.size() - i, values[i]);
+        if (run < minimum_run) {
+            i += run;
+            continue;
+        }
+        if (literal < i) {
+            DataStream::write_varint(stream, (i - literal) << 1);
+            stream << values.subspan(literal, i - literal);
+        }
+        DataStream::write_varint(stream, (run << 1) | 1);
+        stream << values[i];
+        i += run;
+        literal = i;
+    }
+    if (literal < values.size()) {
+        DataStream::write_varint(stream, (values.size() - literal) << 1);
+        stream << values.subspan(literal);
+    }
+}
+
+template <typename S, typename T>
+requires std::is_arithmetic_v<T>
+inline void read_runs(S& stream, std::span<T> values) {
+    if (DataStream::read_varint(stream) != values.size())
+        throw std::length_error("run length encoded size mismatch");
+
+    std::size_t i = 0;
+    while (i < values.size()) {
+        const std::uint64_t header = DataStream::read_varint(stream);
+        const std::size_t length = header >> 1;
+        if (!length) // never written, would not advance
+            throw std::runtime_error("empty run in run length encoded data");
+        if (length > values.size() - i)
+            throw std::out_of_range("run exceeds encoded size");
+        if (header & 1) {
+            T value;
+            stream >> value;
+            std::fill_n(values.data() + i, length, value);
+        } else {
+            stream >> values.subspan(i, length);
+        }
+        i += length;
+    }
+}
+
+
+// same token format as write_runs() on bytes, but only runs of zero bytes are collapsed and carry no value
+template <typename S>
+inline void write_zero_runs(S& stream, std::span<const std::uint8_t> bytes, std::size_t minimum_run = 4) {
+    minimum_run = std::max<std::size_t>(minimum_run, 2);
+    DataStream::write_varint(stream, bytes.size());
+
+    std::size_t literal = 0;
+    std::size_t i = 0;
+    while (i < bytes.size()) {
+        i += DataStream::find_zero(bytes.data() + i, bytes.size() - i);
+        if (i == bytes.size())
+            break;
+        const std::size_t run = DataStream::run_length(bytes.data() + i, bytes.size() - i, std::uint8_t(0));
+        if (run < minimum_run) {
+            i += run;
+            continue;
+        }
+        if (literal < i) {
+            DataStream::write_varint(stream, (i - literal) << 1);
+            stream << bytes.subspan(literal, i - literal);
+        }
+        DataStream::write_varint(stream, (run << 1) | 1);
+        i += run;
+        literal = i;
+    }
+    if (literal < bytes.size()) {
+        DataStream::write_varint(stream, (bytes.size() - literal) << 1);
+        stream << bytes.subspan(literal);
+    }
+}
+
+template <typename S>
+inline void read_zero_runs(S& stream, std::span<std::uint8_t> bytes) {
+    if (DataStream::read_varint(stream) != bytes.size())
+        throw std::length_error("run length encoded size mismatch");
+
+    std::size_t i = 0;
+    while (i < bytes.size()) {
+        const std::uint64_t header = DataStream::read_varint(stream);
+        const std::size_t length = header >> 1;
+        if (!length) // never written, would not advance
+            throw std::runtime_error("empty run in run length encoded data");
+        if (length > bytes.size() - i)
+            throw std::out_of_range("run exceeds encoded size");
+        if (header & 1)
+            std::memset(bytes.data() + i, 0, length);
+        else
+            stream >> bytes.subspan(i, length);
+        i += length;
+    }
+}
+
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "DataStream/DataStream.hpp"
+
+
+
+
+namespace DataStream {
+
+// a message serialized once, new messages are a copy of it with a few fields patched:
+//   DataStream::Placeholder<double> price;
+//   DataStream::MessageTemplate order([&](auto& s) { s << id; price = s.template placeholder<double>(); });
+//   auto message = order.instantiate(buffer); // one copy
+//   message.fill(price, 101.25); // set() at the recorded offset
+// the builder runs twice, once on a SizeCounter to size the prototype exactly and once to store it,
+// so it must serialize the same message both times
+template <std::endian endiannes = std::endian::native>
+class MessageTemplate {
+private:
+    std::vector<std::uint8_t> prototype;
+
+
+public:
+    template <typename Builder>
+    explicit MessageTemplate(Builder&& build) {
+        DataStream::SizeCounter<endiannes> counter;
+        build(counter);
+        this->prototype.resize(counter.size());
+
+        DataStream::Stream<DataStream::Mode::Output, endiannes> stream(this->prototype);
+        build(stream);
+    }
+
+    inline std::size_t size() const { return this->prototype.size(); }
+
+    inline std::span<const std::uint8_t> bytes() const { return this->prototype; }
+
+    // copies the prototype to the start of `buffer` and returns a stream over the buffer positioned
+    // after it, patch the fields with fill() and append anything variable length with operator<<
+    inline DataStream::Stream<DataStream::Mode::Output, endiannes> instantiate(std::span<std::uint8_t> buffer) const {
+        DataStream::Stream<DataStream::Mode::Output, endiannes> stream(buffer);
+        stream << this->bytes();
+        return stream;
+    }
+};
+
+}